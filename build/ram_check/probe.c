@@ -0,0 +1,5 @@
+#include "buttons_budget.h"
+char ramCore[BUTTONS_CORE_RAM];
+#if BUTTONS_TRACE
+char ramTrace[BUTTONS_TRACE_RAM - sizeof(ButtonTraceSink)];
+#endif
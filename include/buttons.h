@@ -45,6 +45,9 @@
 		}
 	}
  *
+ * Optional features (virtual buttons, timing profiles, descriptor tables, telemetry,
+ * tracing, edge injection, listeners...) are described in README.md.
+ *
  * Additionally, the timer triggered function has to be checked externally of this api (e.g. in main.c)
  * The timer instance that was passed to buttons_init() can check for the button timer and action accordingly.
  * Because a button's state will only change to
@@ -81,6 +84,7 @@
 #endif
 
 #include <stdint.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -123,6 +127,40 @@ extern "C" {
 #define MULTIPLE_BUTTON_TIME 100
 #endif
 
+// Set to 1 for dual contact (velocity sensitive) buttons
+#ifndef BUTTONS_VELOCITY
+#define BUTTONS_VELOCITY 0
+#endif
+
+// Set to 1 to count cycles spent in the interrupt and poll entry points
+#ifndef BUTTONS_PROFILE
+#define BUTTONS_PROFILE 0
+#endif
+
+// Set to 1 to keep per button actuation, hold time and bounce statistics
+#ifndef BUTTONS_TELEMETRY
+#define BUTTONS_TELEMETRY 0
+#endif
+// Bounce trend, as a percentage of the debounce window, at which a switch is flagged as worn
+#ifndef BUTTONS_TELEMETRY_WEAR_PERCENT
+#define BUTTONS_TELEMETRY_WEAR_PERCENT 75
+#endif
+
+// Set to 1 to report every edge and event to a trace callback, see buttons_trace.h
+#ifndef BUTTONS_TRACE
+#define BUTTONS_TRACE 0
+#endif
+
+// Number of equal steps the hold time is divided into for HoldProgress events (0 disables them)
+#ifndef BUTTON_HOLD_PROGRESS_STEPS
+#define BUTTON_HOLD_PROGRESS_STEPS 0
+#endif
+
+// Set to 1 to stamp edges with the audio frame counter (see ButtonAudioClock)
+#ifndef BUTTONS_AUDIO_CLOCK
+#define BUTTONS_AUDIO_CLOCK 0
+#endif
+
 typedef enum
 {
 	ActiveLow,
@@ -139,7 +177,9 @@ typedef enum
 	Held,
 	HeldReleased,
 	Cleared,
-	HeldRepeat
+	HeldRepeat,
+	HoldProgress,
+	PressureChanged
 } ButtonState;
 
 typedef enum
@@ -156,6 +196,13 @@ typedef enum
 	latching
 } ButtonMode;
 
+// Where a button's edges come from
+typedef enum
+{
+	ButtonPhysical,		// GPIO pin, read in buttons_ExtiGpioCallback()
+	ButtonVirtual		// No pin. Edges are injected with buttons_VirtualEdge() (eg. MIDI, USB, web UI)
+} ButtonSource;
+
 typedef enum
 {
 	ButtonPending,
@@ -163,8 +210,70 @@ typedef enum
 	ButtonContinue
 } ButtonBinaryDecision;
 
-// Stores data related to each button
+/* Timing for a class of switch (eg. soft touch, stomp, tactile), all in ms.
+ * Buttons select a profile by index, see buttons_PublishConfig()
+ */
+typedef struct
+{
+	uint16_t debounceLowToHigh;
+	uint16_t debounceHighToLow;
+	uint16_t doublePressTime;
+	uint16_t holdTime;				// 0 uses the hold time of buttons_SetHoldTimer()/buttons_SetHoldTime()
+} ButtonTimingProfile;
+
+#if BUTTONS_TELEMETRY
 typedef struct
+{
+	uint32_t actuations;
+	uint32_t heldTime;				// ms pressed in total
+	uint16_t bounceLowToHigh;		// running average of bounce rejected by debounceLowToHigh, ms x 16
+	uint16_t bounceHighToLow;		// running average of bounce rejected by debounceHighToLow, ms x 16
+} ButtonTelemetry;
+#endif
+
+#if BUTTONS_VELOCITY
+/* Piecewise linear map from contact delta (us, ascending) to velocity (usually descending).
+ * Deltas outside the table are clamped to the first/last point.
+ */
+typedef struct
+{
+	const uint32_t* delta;
+	const uint8_t* velocity;
+	uint8_t numPoints;
+} ButtonVelocityCurve;
+#endif
+
+// Runtime configuration, published as a whole with buttons_PublishConfig()
+typedef struct
+{
+	const ButtonTimingProfile* profiles;
+	uint8_t numProfiles;
+#if BUTTONS_VELOCITY
+	const ButtonVelocityCurve* velocityCurve;
+#endif
+} ButtonConfig;
+
+#define BUTTON_STATE_MASK(state) (1u << (state))
+
+struct Button;
+
+/* Subscriber to the events of a button or group, called from the poll dispatcher.
+ * Nodes are owned by the caller (eg. a subsystem or a coroutine frame).
+ */
+typedef struct ButtonListener
+{
+	// Assign in application
+	uint16_t stateMask;									// BUTTON_STATE_MASK() of each state to listen for
+	uint8_t oneShot;										// remove the listener after its first event
+	void (*callback)(struct ButtonListener* listener, struct Button* button, ButtonState state);
+	void* context;
+	// Private
+	struct ButtonListener* next;
+	uint32_t addedDispatch;
+} ButtonListener;
+
+// Stores data related to each button
+typedef struct Button
 {
    // Assign in application
 	ButtonMode mode;				    		// physical hardware type of the button (eg. latching or momentary)
@@ -174,6 +283,9 @@ typedef struct
 #if FRAMEWORK_STM32CUBE
     GPIO_TypeDef *port;						// hardware port
 #endif
+	ButtonSource source;						// ButtonPhysical (default) or ButtonVirtual. Virtual buttons leave pin/port unassigned
+	uint8_t profile;							// index into the timing profile table (0 = default)
+	uint8_t debounceBypass;					// Set to skip debounce timing (eg. for already clean software sources)
    // Private
 	volatile ButtonState state;		    	// current state of button. Also used to trigger polled handler functions
 	volatile ButtonState lastState;     	// previous state of button (used for toggling and debouncing)
@@ -183,19 +295,206 @@ typedef struct
 	volatile uint8_t accelerationTrigger;
 	uint8_t pressEvent;							// Stores whether a press event has occured so that the release event is cancelled
 	volatile uint8_t timerTriggered;
+	ButtonListener* listeners;					// only touched from the poll context
+	uint32_t dispatchCount;						// stamps listeners added during a dispatch
+	uint32_t pressDuration;						// ms from press to release, valid in Released/DoublePressReleased/HeldReleased
+	uint8_t holdProgress;						// hold steps elapsed, out of BUTTON_HOLD_PROGRESS_STEPS
+	volatile uint8_t holdProgressTrigger;
+	volatile uint8_t pressureTrigger;			// set by pressure inputs, see buttons_fsr.h
+#if BUTTONS_AUDIO_CLOCK
+	volatile uint32_t edgeFrame;				// audio frame counter at the last accepted edge
+#endif
+#if BUTTONS_VELOCITY
+	// Assign in application (leave firstContactPin 0 for single contact buttons)
+	uint16_t firstContactPin;
+#if FRAMEWORK_STM32CUBE
+	GPIO_TypeDef *firstContactPort;
+#endif
+	// Private
+	volatile uint32_t firstContactTime;		// us
+	volatile uint8_t firstContactValid;
+	volatile uint32_t contactDelta;			// us between first and second contact of the last press
+#endif
+#if BUTTONS_TELEMETRY
+	// Private, see buttons_GetTelemetry()
+	volatile uint32_t actuations;
+	volatile uint32_t heldTime;
+	volatile uint16_t bounceLowToHigh;		// ms from the last accepted edge to the latest release it rejected
+	volatile uint16_t bounceHighToLow;		// ms from the last accepted edge to the latest press it rejected
+	uint16_t bounceTrendLowToHigh;
+	uint16_t bounceTrendHighToLow;
+#endif
 } Button;
 
+#if BUTTONS_AUDIO_CLOCK
+/* Running audio frame counter, derived from the I2S/SAI DMA.
+ * The frame count is blockIndex * blockSize plus the position within the current block,
+ * so edges are located to the exact sample rather than the ms tick.
+ * The DMA half/full complete interrupt must have a higher priority than the button
+ * interrupts, so it can't be left pending behind one while the DMA has already wrapped
+ * (which would put the edge a whole block early). If it preempts between the block index
+ * and position reads, the read is simply repeated.
+ */
+typedef struct
+{
+	// Assign in application
+	uint16_t blockSize;						// frames per DMA block (eg. half of a circular buffer)
+	uint16_t (*getBlockPosition)(void);	// frames transferred within the current block, eg. blockSize - NDTR/channels
+	uint32_t sampleRate;					// Hz, places virtual edges with an earlier timestamp (0 to stamp them now)
+	// Private
+	volatile uint32_t blockIndex;
+} ButtonAudioClock;
+#endif
+
+#if BUTTONS_PROFILE
+// Instrumented entry points
+typedef enum
+{
+	ButtonProfileExti,			// buttons_ExtiGpioCallback()
+	ButtonProfilePoll,			// buttons_TriggerPoll()/buttons_GroupTriggerPoll(), including handlers
+	ButtonProfileHoldTimer,		// buttons_HoldTimerElapsed()
+	ButtonProfileCount
+} ButtonProfilePoint;
+
+// State machine inputs of an edge
+typedef struct
+{
+	ButtonState lastState;
+	uint8_t timerTriggered;
+	uint8_t edge;				// 0 = press, 1 = release
+	uint32_t sinceLastEdge;		// ms since the button's lastTime
+} ButtonProfileInput;
+
+typedef struct
+{
+	uint32_t calls;
+	uint32_t lastCycles;
+	uint32_t maxCycles;
+	uint64_t totalCycles;
+	ButtonProfileInput worstInput;	// inputs of the maxCycles call, edge entry points only
+} ButtonProfileStats;
+#endif
+
+#if BUTTONS_TRACE
+typedef enum
+{
+	ButtonTraceEdge,			// accepted edge, value 1 = press
+	ButtonTraceRejected,		// edge rejected by debounce timing, value 1 = press
+	ButtonTraceEvent,			// dispatched event, value is the ButtonState
+	ButtonTraceDropped			// records lost by a trace sink
+} ButtonTraceType;
+#endif
+
+// A single timestamped edge for batched injection with buttons_InjectEdges()
+typedef struct
+{
+	uint16_t button;		// index of the button within the group
+	uint8_t level;			// logical level, 1 = pressed, 0 = released
+	uint32_t timestamp;	// ms, on the group's virtual clock
+} ButtonEdge;
+
+// Constant description of a button, so a whole panel's configuration can live in flash
+typedef struct
+{
+	ButtonMode mode;
+	ButtonLogic logicMode;
+	void (*handler)(ButtonState state);
+	uint16_t pin;
+#if FRAMEWORK_STM32CUBE
+	GPIO_TypeDef *port;
+#endif
+	ButtonSource source;
+	uint8_t profile;
+	uint8_t debounceBypass;
+} ButtonDesc;
+
+// Value of an EXTI lookup entry without a button
+#define BUTTONS_NO_EXTI 0xFFFF
+
+// A set of buttons with its own virtual clock, used for injected edges
+typedef struct
+{
+	Button* buttons;
+	uint16_t numButtons;
+	// Private
+#if FRAMEWORK_STM32CUBE
+	uint16_t extiButtons[16];			// button index for each EXTI line
+#endif
+	const ButtonConfig* config;			// NULL to use the published configuration
+	uint32_t virtualTime;
+	uint8_t virtualClock;				// driven by buttons_InjectEdges()/buttons_AdvanceVirtualTime() since init
+	uint32_t holdStart;
+	uint16_t holdDuration;
+	uint8_t holdStep;
+	uint8_t holdRunning;
+	ButtonListener* listeners;
+	uint32_t dispatchCount;
+	uint32_t debounceFails;				// edges rejected by debounce timing
+	uint32_t stateEpoch;				// bumped by injected edges, in place of the global epoch
+	uint8_t injecting;					// events come from buttons_InjectEdges()/buttons_AdvanceVirtualTime()
+} ButtonGroup;
+
 //-------------- PUBLIC FUNCTION PROTOTYPES --------------//
 #if FRAMEWORK_ARDUINO
 void buttons_AssignTimerStopCallback(void (*callback)(void));
 void buttons_AssignTimerStartCallback(void (*callback)(void));
 void buttons_AssignTimerGetCounterCallback(uint32_t (*callback)(void));
+void buttons_SetHoldTime(uint16_t time);
 #elif FRAMEWORK_STM32CUBE
 void buttons_SetHoldTimer(TIM_HandleTypeDef *timHandle, uint16_t time);
 #endif
 void buttons_Init(Button* button);
+const ButtonConfig* buttons_PublishConfig(const ButtonConfig* config);
+const ButtonConfig* buttons_GetConfig(void);
 
 void buttons_ExtiGpioCallback(Button* button, ButtonEmulateAction emulateAction);
+void buttons_AddListener(Button* button, ButtonListener* listener);
+void buttons_RemoveListener(Button* button, ButtonListener* listener);
+void buttons_VirtualEdge(Button* button, ButtonEmulateAction action, uint32_t timestamp);
+#if BUTTONS_AUDIO_CLOCK
+void buttons_SetAudioClock(ButtonAudioClock* clock);
+void buttons_AudioBlockComplete(ButtonAudioClock* clock);
+uint32_t buttons_AudioFrameNow(ButtonAudioClock* clock);
+int32_t buttons_AudioEventOffset(Button* button, uint32_t blockStartFrame);
+#endif
+#if BUTTONS_VELOCITY
+void buttons_AssignMicrosecondCallback(uint32_t (*callback)(void));
+void buttons_FirstContactCallback(Button* button);
+uint8_t buttons_GetVelocity(Button* button);
+#endif
+#if BUTTONS_TELEMETRY
+void buttons_GetTelemetry(Button* button, ButtonTelemetry* telemetry);
+void buttons_RestoreTelemetry(Button* button, const ButtonTelemetry* telemetry);
+uint8_t buttons_PersistTelemetry(Button* buttons, ButtonTelemetry* persisted, uint16_t numButtons, uint32_t minActuations,
+									void (*write)(const ButtonTelemetry* telemetry, uint16_t numButtons));
+uint8_t buttons_TelemetryWorn(Button* button);
+#endif
+#if BUTTONS_PROFILE
+void buttons_AssignCycleCounterCallback(uint32_t (*callback)(void));
+void buttons_ProfileInit(void);
+void buttons_ProfileReset(void);
+const ButtonProfileStats* buttons_GetProfileStats(ButtonProfilePoint point);
+#endif
+#if BUTTONS_TRACE
+void buttons_AssignTraceCallback(void (*callback)(Button* button, ButtonTraceType type, uint8_t value, uint32_t timestamp));
+#endif
+void buttons_InitGroup(ButtonGroup* group, Button* buttons, uint16_t numButtons, const ButtonDesc* table);
+#if FRAMEWORK_STM32CUBE
+void buttons_GroupExtiCallback(ButtonGroup* group, uint16_t pin);
+#endif
+void buttons_AddGroupListener(ButtonGroup* group, ButtonListener* listener);
+void buttons_RemoveGroupListener(ButtonGroup* group, ButtonListener* listener);
+void buttons_GroupTriggerPoll(ButtonGroup* group);
+void buttons_InjectEdges(ButtonGroup* group, const ButtonEdge* edges, size_t n);
+void buttons_AdvanceVirtualTime(ButtonGroup* group, uint32_t timestamp);
+void buttons_SetGroupConfig(ButtonGroup* group, const ButtonConfig* config);
+uint32_t buttons_GetGroupDebounceFails(ButtonGroup* group);
+uint32_t buttons_GetGroupStateEpoch(ButtonGroup* group);
+uint16_t buttons_GetHoldTime(Button* button);
+uint8_t buttons_IsPressed(Button* button);
+void buttons_TakeEvent(ButtonGroup* group, Button* button, ButtonState state);
+uint32_t buttons_GetStateEpoch(void);
+void buttons_BumpStateEpoch(void);
 void buttons_HoldTimerElapsed(Button* buttons, uint16_t numButtons);
 void buttons_TriggerPoll(Button* buttons, uint16_t numButtons);
 
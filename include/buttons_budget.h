@@ -0,0 +1,101 @@
+/*
+ * buttons_budget.h
+ *
+ * Compile time RAM accounting.
+ *
+ * The macros below are constant expressions, so an application can check its input
+ * handling against a fixed budget at build time:
+ *
+	BUTTONS_ASSERT_RAM(BUTTONS_RAM(NUM_BUTTONS) + sizeof(ButtonLink) + BUTTONS_TRACE_RAM, 2048);
+ *
+ * They follow the enabled features and queue size macros, so they must see the same
+ * definitions as the library build. Module objects (ButtonLink, ButtonMidi, ButtonHid,
+ * ButtonEventQueue, ButtonFsr, ButtonScanPort...) are owned by the application, their
+ * RAM is their sizeof. Constant tables (default timing profile, configurations,
+ * descriptor tables) are in flash.
+ *
+ * The library's own globals are an estimate: the sum of their sizes, without the alignment
+ * padding the linker puts between them, which may add a few bytes. tools/ram_check.sh
+ * compares the estimate with the symbol sizes of a build, or with the sections of a
+ * firmware's linker map.
+ */
+#ifndef BUTTONS_BUDGET_H_
+#define BUTTONS_BUDGET_H_
+
+#include "buttons.h"
+#if BUTTONS_TRACE
+#include "buttons_trace.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Hold timer handle or callbacks
+#if FRAMEWORK_STM32CUBE
+#define BUTTONS_RAM_TIMER	sizeof(TIM_HandleTypeDef*)
+#else
+#define BUTTONS_RAM_TIMER	(3 * sizeof(void (*)(void)))
+#endif
+
+#if BUTTON_HOLD_PROGRESS_STEPS > 1
+#define BUTTONS_RAM_HOLD_PROGRESS	sizeof(uint8_t)
+#else
+#define BUTTONS_RAM_HOLD_PROGRESS	0
+#endif
+
+#if BUTTONS_VELOCITY
+#define BUTTONS_RAM_VELOCITY	sizeof(uint32_t (*)(void))
+#else
+#define BUTTONS_RAM_VELOCITY	0
+#endif
+
+#if BUTTONS_TRACE
+#define BUTTONS_RAM_TRACE_HOOK	sizeof(void (*)(void))
+#else
+#define BUTTONS_RAM_TRACE_HOOK	0
+#endif
+
+#if BUTTONS_PROFILE
+#define BUTTONS_RAM_PROFILE	(ButtonProfileCount * sizeof(ButtonProfileStats) + sizeof(uint32_t (*)(void)))
+#else
+#define BUTTONS_RAM_PROFILE	0
+#endif
+
+#if BUTTONS_AUDIO_CLOCK
+#define BUTTONS_RAM_AUDIO_CLOCK	sizeof(ButtonAudioClock*)
+#else
+#define BUTTONS_RAM_AUDIO_CLOCK	0
+#endif
+
+// Globals of buttons.c: debounceFail, timerConfigured, buttonHoldTime, activeConfig, stateEpoch and the above
+#define BUTTONS_CORE_RAM	(2 * sizeof(uint8_t) + sizeof(uint16_t) + sizeof(const ButtonConfig*) + sizeof(uint32_t) + \
+							BUTTONS_RAM_TIMER + BUTTONS_RAM_HOLD_PROGRESS + BUTTONS_RAM_VELOCITY + \
+							BUTTONS_RAM_TRACE_HOOK + BUTTONS_RAM_PROFILE + BUTTONS_RAM_AUDIO_CLOCK)
+
+// A ButtonGroup and its buttons
+#define BUTTONS_GROUP_RAM(numButtons)	(sizeof(ButtonGroup) + (numButtons) * sizeof(Button))
+
+// Library globals plus one group of buttons
+#define BUTTONS_RAM(numButtons)	(BUTTONS_CORE_RAM + BUTTONS_GROUP_RAM(numButtons))
+
+// Trace sink and its globals, see buttons_trace.h
+#if BUTTONS_TRACE
+#define BUTTONS_TRACE_RAM	(sizeof(ButtonTraceSink) + sizeof(ButtonTraceSink*))
+#else
+#define BUTTONS_TRACE_RAM	0
+#endif
+
+#ifdef __cplusplus
+#define BUTTONS_ASSERT_RAM(used, budget) \
+	static_assert((used) <= (budget), "Button handling exceeds its RAM budget")
+#else
+#define BUTTONS_ASSERT_RAM(used, budget) \
+	_Static_assert((used) <= (budget), "Button handling exceeds its RAM budget")
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BUTTONS_BUDGET_H_ */
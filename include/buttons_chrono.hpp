@@ -0,0 +1,121 @@
+/*
+ * buttons_chrono.hpp
+ *
+ * std::chrono layer over the library's timing.
+ *
+ * Every time in the C API is a bare integer count of milliseconds, the unit of
+ * HAL_GetTick()/millis() (HAL_GetTick() counts ms whatever uwTickFreq is set to, it only
+ * steps in larger increments): Button::lastTime, ButtonTimingProfile, buttons_SetHoldTimer()
+ * and so on. Here those become buttons::ticks durations and buttons::tick_clock time points,
+ * both in ms. Durations convert implicitly from coarser units, while finer ones such as
+ * microseconds are a compile error rather than silently truncated, and std::chrono::ceil/floor
+ * make the rounding explicit:
+ *
+	using namespace std::chrono_literals;
+	constexpr ButtonTimingProfile footswitch = buttons::timing_profile(20ms, 5ms, 300ms, 1s);
+	buttons::set_hold_timer(&htim6, 800ms);
+ *
+ * All conversions are constant expressions folded by the compiler, so the calls compile
+ * to the same integer code as the C API. Values too large for a 16 bit field fail to
+ * compile when used in a constant expression, and saturate otherwise.
+ */
+#ifndef BUTTONS_CHRONO_HPP_
+#define BUTTONS_CHRONO_HPP_
+
+#include "buttons.h"
+#include <chrono>
+#include <cstdint>
+#include <ratio>
+
+namespace buttons
+{
+
+struct tick_clock
+{
+	using rep = uint32_t;
+	using period = std::milli;
+	using duration = std::chrono::duration<rep, period>;
+	using time_point = std::chrono::time_point<tick_clock>;
+	static constexpr bool is_steady = true;
+
+	static time_point now() noexcept
+	{
+#if FRAMEWORK_STM32CUBE
+		return time_point(duration(HAL_GetTick()));
+#elif FRAMEWORK_ARDUINO
+		return time_point(duration(millis()));
+#endif
+	}
+};
+
+using ticks = tick_clock::duration;
+
+namespace detail
+{
+
+// Not constexpr, so reaching it in a constant expression is a compile error
+inline uint16_t out_of_range() { return 0xFFFF; }
+
+constexpr uint16_t to_field(ticks time)
+{
+	return time.count() > 0xFFFF ? out_of_range() : static_cast<uint16_t>(time.count());
+}
+
+} // namespace detail
+
+// Timing profile from durations. holdTime of zero uses the global hold time
+constexpr ButtonTimingProfile timing_profile(ticks debounceLowToHigh, ticks debounceHighToLow,
+												ticks doublePressTime, ticks holdTime = ticks::zero())
+{
+	return ButtonTimingProfile{detail::to_field(debounceLowToHigh), detail::to_field(debounceHighToLow),
+								detail::to_field(doublePressTime), detail::to_field(holdTime)};
+}
+
+// Global hold time, with the hardware hold timer on STM32Cube
+#if FRAMEWORK_STM32CUBE
+inline void set_hold_timer(TIM_HandleTypeDef* timHandle, ticks time)
+{
+	buttons_SetHoldTimer(timHandle, detail::to_field(time));
+}
+#elif FRAMEWORK_ARDUINO
+inline void set_hold_time(ticks time)
+{
+	buttons_SetHoldTime(detail::to_field(time));
+}
+#endif
+
+inline ticks hold_time(Button& button)
+{
+	return ticks(buttons_GetHoldTime(&button));
+}
+
+// Time of the last accepted edge
+inline tick_clock::time_point last_edge(const Button& button)
+{
+	return tick_clock::time_point(ticks(button.lastTime));
+}
+
+// Press length, valid in Released, DoublePressReleased and HeldReleased
+inline ticks press_duration(const Button& button)
+{
+	return ticks(button.pressDuration);
+}
+
+inline void virtual_edge(Button& button, ButtonEmulateAction action, tick_clock::time_point when)
+{
+	buttons_VirtualEdge(&button, action, when.time_since_epoch().count());
+}
+
+inline void advance_virtual_time(ButtonGroup& group, tick_clock::time_point when)
+{
+	buttons_AdvanceVirtualTime(&group, when.time_since_epoch().count());
+}
+
+constexpr ButtonEdge edge(uint16_t button, bool pressed, tick_clock::time_point when)
+{
+	return ButtonEdge{button, static_cast<uint8_t>(pressed), when.time_since_epoch().count()};
+}
+
+} // namespace buttons
+
+#endif /* BUTTONS_CHRONO_HPP_ */
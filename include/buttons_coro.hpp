@@ -0,0 +1,348 @@
+/*
+ * buttons_coro.hpp
+ *
+ * C++20 coroutine layer over button events.
+ *
+ * UI flows can be written as straight line code instead of nested callbacks:
+ *
+	buttons::Task tapTempo()
+	{
+		for(;;)
+		{
+			co_await buttons::next(fs[FS3], Pressed);
+			auto which = co_await buttons::any_of(buttons::next(fs[FS1], Pressed),
+			                                        buttons::next(fs[FS2], Pressed));
+			if(which.index == 0 && co_await buttons::held_for(fs[FS1], 2000))
+			{
+				...
+			}
+		}
+	}
+ *
+ * Coroutines are resumed directly from buttons_TriggerPoll() through the button's
+ * one-shot ButtonListener list, so an event only visits the coroutines waiting on that button.
+ * held_for() is time based, call buttons::tick() with the current ms time (or
+ * buttons::tick_clock::now()) from the main loop for it to complete. Both also take
+ * std::chrono types, see buttons_chrono.hpp.
+ *
+ * Coroutine frames come from a static pool of BUTTONS_CORO_MAX_TASKS blocks of
+ * BUTTONS_CORO_FRAME_SIZE bytes, no heap is used. If the pool is exhausted (or a frame
+ * is too large), the coroutine doesn't start and Task::valid() returns false.
+ * Everything runs in the poll context, never from an interrupt.
+ */
+#ifndef BUTTONS_CORO_HPP_
+#define BUTTONS_CORO_HPP_
+
+#include "buttons.h"
+#include "buttons_chrono.hpp"
+#include <array>
+#include <coroutine>
+#include <cstddef>
+
+// Maximum number of coroutines alive at once
+#ifndef BUTTONS_CORO_MAX_TASKS
+#define BUTTONS_CORO_MAX_TASKS 4
+#endif
+// Bytes available for each coroutine frame
+#ifndef BUTTONS_CORO_FRAME_SIZE
+#define BUTTONS_CORO_FRAME_SIZE 512
+#endif
+
+// RAM of the frame pool and the held_for() wait list, for use with buttons_budget.h
+#define BUTTONS_CORO_RAM (BUTTONS_CORO_MAX_TASKS * (BUTTONS_CORO_FRAME_SIZE + sizeof(bool)) + sizeof(void*))
+
+namespace buttons
+{
+
+namespace detail
+{
+
+// Fixed block allocator for coroutine frames
+template<std::size_t BlockSize, std::size_t Blocks>
+class FramePool
+{
+public:
+	void* allocate(std::size_t size) noexcept
+	{
+		if(size > BlockSize)
+		{
+			return nullptr;
+		}
+		for(std::size_t i=0; i<Blocks; i++)
+		{
+			if(!used[i])
+			{
+				used[i] = true;
+				return storage[i];
+			}
+		}
+		return nullptr;
+	}
+
+	void deallocate(void* frame) noexcept
+	{
+		for(std::size_t i=0; i<Blocks; i++)
+		{
+			if(frame == storage[i])
+			{
+				used[i] = false;
+				return;
+			}
+		}
+	}
+
+private:
+	alignas(std::max_align_t) unsigned char storage[Blocks][BlockSize];
+	bool used[Blocks] = {};
+};
+
+inline FramePool<BUTTONS_CORO_FRAME_SIZE, BUTTONS_CORO_MAX_TASKS> framePool;
+
+} // namespace detail
+
+// Fire and forget coroutine. The frame is released when the coroutine finishes
+class Task
+{
+public:
+	struct promise_type
+	{
+		static void* operator new(std::size_t size) noexcept { return detail::framePool.allocate(size); }
+		static void operator delete(void* frame) noexcept { detail::framePool.deallocate(frame); }
+		static Task get_return_object_on_allocation_failure() noexcept { return Task(false); }
+
+		Task get_return_object() noexcept { return Task(true); }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() noexcept {}
+		void unhandled_exception() noexcept {}
+	};
+
+	bool valid() const { return started; }
+
+private:
+	explicit Task(bool started) : started(started) {}
+	bool started;
+};
+
+// Set of states to wait for, eg. states(Pressed, DoublePressed)
+struct StateMask
+{
+	uint16_t bits;
+};
+
+template<typename... States>
+constexpr StateMask states(States... s)
+{
+	return StateMask{static_cast<uint16_t>((BUTTON_STATE_MASK(s) | ...))};
+}
+
+// co_await next(button, state) resumes on the next matching event and yields the state
+class NextAwaiter
+{
+public:
+	NextAwaiter(Button& button, StateMask mask) : button(&button)
+	{
+		waiter.stateMask = mask.bits;
+		waiter.oneShot = 1;
+		waiter.callback = &NextAwaiter::onEvent;
+		waiter.context = this;
+		waiter.next = nullptr;
+	}
+
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<> handle) noexcept
+	{
+		continuation = handle;
+		buttons_AddListener(button, &waiter);
+	}
+	ButtonState await_resume() const noexcept { return state; }
+
+private:
+	template<std::size_t N> friend class AnyOfAwaiter;
+
+	static void onEvent(ButtonListener* node, Button*, ButtonState event)
+	{
+		NextAwaiter* self = static_cast<NextAwaiter*>(node->context);
+		self->state = event;
+		self->continuation.resume();
+	}
+
+	Button* button;
+	ButtonListener waiter;
+	ButtonState state = Cleared;
+	std::coroutine_handle<> continuation;
+};
+
+inline NextAwaiter next(Button& button, ButtonState state)
+{
+	return NextAwaiter(button, states(state));
+}
+
+inline NextAwaiter next(Button& button, StateMask mask)
+{
+	return NextAwaiter(button, mask);
+}
+
+// Result of any_of(): which awaiter fired first and with what state
+struct AnyOfResult
+{
+	std::size_t index;
+	ButtonState state;
+};
+
+// co_await any_of(next(...), next(...)) resumes on the first event of any of them
+template<std::size_t N>
+class AnyOfAwaiter
+{
+public:
+	explicit AnyOfAwaiter(const std::array<NextAwaiter, N>& awaiters) : awaiters(awaiters) {}
+
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<> handle) noexcept
+	{
+		continuation = handle;
+		for(std::size_t i=0; i<N; i++)
+		{
+			awaiters[i].waiter.callback = &AnyOfAwaiter::onEvent;
+			awaiters[i].waiter.context = this;
+			buttons_AddListener(awaiters[i].button, &awaiters[i].waiter);
+		}
+	}
+	AnyOfResult await_resume() const noexcept { return result; }
+
+private:
+	static void onEvent(ButtonListener* node, Button*, ButtonState event)
+	{
+		AnyOfAwaiter* self = static_cast<AnyOfAwaiter*>(node->context);
+		// The fired waiter is already detached, withdraw the others before resuming
+		for(std::size_t i=0; i<N; i++)
+		{
+			if(&self->awaiters[i].waiter == node)
+			{
+				self->result.index = i;
+			}
+			else
+			{
+				buttons_RemoveListener(self->awaiters[i].button, &self->awaiters[i].waiter);
+			}
+		}
+		self->result.state = event;
+		self->continuation.resume();
+	}
+
+	std::array<NextAwaiter, N> awaiters;
+	AnyOfResult result = {0, Cleared};
+	std::coroutine_handle<> continuation;
+};
+
+template<typename... Awaiters>
+AnyOfAwaiter<sizeof...(Awaiters)> any_of(Awaiters... awaiters)
+{
+	return AnyOfAwaiter<sizeof...(Awaiters)>(std::array<NextAwaiter, sizeof...(Awaiters)>{awaiters...});
+}
+
+/* co_await held_for(button, ms) yields true once the button has been held down for
+ * the given time, or false if it is released first. If the button isn't down yet,
+ * the next press starts the wait.
+ */
+class HeldForAwaiter
+{
+public:
+	HeldForAwaiter(Button& button, uint32_t duration) : button(&button), duration(duration) {}
+
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<> handle) noexcept
+	{
+		continuation = handle;
+		start = button->lastTime;
+		seenPress = buttons_IsPressed(button);
+		next = head();
+		head() = this;
+	}
+	bool await_resume() const noexcept { return held; }
+
+	// Timed waiters are few, so a linear walk of them per tick is fine
+	static void tick(uint32_t now)
+	{
+		HeldForAwaiter** link = &head();
+		while(*link != nullptr)
+		{
+			HeldForAwaiter* waiter = *link;
+			if(waiter->check(now))
+			{
+				*link = waiter->next;
+				waiter->continuation.resume();
+			}
+			else
+			{
+				link = &waiter->next;
+			}
+		}
+	}
+
+private:
+	static HeldForAwaiter*& head()
+	{
+		static HeldForAwaiter* first = nullptr;
+		return first;
+	}
+
+	bool check(uint32_t now)
+	{
+		if(buttons_IsPressed(button))
+		{
+			// A new press since the wait started restarts the measurement
+			if(!seenPress || button->lastTime != start)
+			{
+				seenPress = true;
+				start = button->lastTime;
+			}
+			if(now - start >= duration)
+			{
+				held = true;
+				return true;
+			}
+			return false;
+		}
+		// Released, either after the press that was being timed or after a press too short to see
+		if(seenPress || button->lastTime != start)
+		{
+			held = false;
+			return true;
+		}
+		return false;
+	}
+
+	Button* button;
+	uint32_t duration;
+	uint32_t start = 0;
+	bool seenPress = false;
+	bool held = false;
+	HeldForAwaiter* next = nullptr;
+	std::coroutine_handle<> continuation;
+};
+
+inline HeldForAwaiter held_for(Button& button, uint32_t duration)
+{
+	return HeldForAwaiter(button, duration);
+}
+
+inline HeldForAwaiter held_for(Button& button, ticks duration)
+{
+	return HeldForAwaiter(button, duration.count());
+}
+
+// Completes held_for() waits, call from the main loop with the current ms time
+inline void tick(uint32_t now)
+{
+	HeldForAwaiter::tick(now);
+}
+
+inline void tick(tick_clock::time_point now)
+{
+	HeldForAwaiter::tick(now.time_since_epoch().count());
+}
+
+} // namespace buttons
+
+#endif /* BUTTONS_CORO_HPP_ */
@@ -0,0 +1,171 @@
+/*
+ * buttons_exti.hpp
+ *
+ * Compile time EXTI line planning for STM32 pin assignments.
+ *
+ * On STM32 all pins with the same number share one EXTI line (PA3, PB3, PC3 ... are all
+ * EXTI3), so only one of them can interrupt. buttons_InitGroup() silently lets the last
+ * one win. Listing the pins of a descriptor table here, in the same order, turns that
+ * into a build error:
+ *
+	constexpr std::array<buttons::ExtiPin, 4> panelPins =
+	{{
+		{GPIO_PIN_0},			// PA0
+		{GPIO_PIN_3},			// PA3
+		{GPIO_PIN_3},			// PB3, conflicts with PA3
+		{GPIO_PIN_5, true},		// PC5, scanned, needs no line
+	}};
+	BUTTONS_ASSERT_EXTI(panelPins);
+ *
+ * The line only depends on the pin number, so the port isn't listed (port pointers
+ * aren't constant expressions either). The error names the first conflict as
+ * ExtiConflict<button, holder, true>: the index of the button that lost its line and
+ * of the earlier one holding it (the same index for a pin mask of several bits).
+ * Earlier entries keep the line, so order the table by how much each button needs an
+ * interrupt. buttons::planExti(panelPins).demote marks the buttons that lost their line;
+ * make those ButtonVirtual and scan them with buttons_ScanProcess() (see buttons_scan.h)
+ * instead.
+ *
+ * The plan also holds the EXTI line to button dispatch table, so it can live in flash.
+ * Initialise the group through buttons::initGroup(), which returns false when the
+ * descriptor table's pins have drifted from the plan:
+ *
+	static constexpr auto panelPlan = buttons::planExti(panelPins);
+
+	if(!buttons::initGroup(&group, panel, panelTable, panelPlan))
+	{
+		Error_Handler();
+	}
+
+	void HAL_GPIO_EXTI_Callback(uint16_t pin)
+	{
+		buttons::dispatchExti(panelPlan, panel, pin);
+	}
+ */
+#ifndef BUTTONS_EXTI_HPP_
+#define BUTTONS_EXTI_HPP_
+
+#include "buttons.h"
+#include <array>
+#include <cstddef>
+
+// Rejects a pin list with EXTI line conflicts at compile time, naming the first conflict
+#define BUTTONS_ASSERT_EXTI(pins) \
+	static_assert(::buttons::detail::ExtiConflict<::buttons::planExti(pins).conflict, \
+		::buttons::planExti(pins).conflictHolder, (::buttons::planExti(pins).conflicts != 0)>::ok, \
+		"Buttons share an EXTI line, buttons::planExti(" #pins ").demote lists the ones to scan instead")
+
+namespace buttons
+{
+
+struct ExtiPin
+{
+	uint16_t pin;				// GPIO_PIN_x, a single bit
+	bool polled = false;		// scanned rather than interrupt driven, needs no line
+};
+
+template<std::size_t N>
+struct ExtiPlan
+{
+	std::array<uint16_t, 16> dispatch;		// button index per EXTI line, BUTTONS_NO_EXTI if unused
+	std::array<bool, N> demote;				// buttons to move to polled scanning
+	std::size_t conflicts;					// number of demoted buttons
+	std::size_t conflict;					// first demoted button
+	std::size_t conflictHolder;				// button holding its line
+	uint16_t lines;							// mask of EXTI lines in use
+};
+
+namespace detail
+{
+
+// Instantiated with the first conflict, so the compiler's error shows the button indexes
+template<std::size_t Button, std::size_t Holder, bool Conflict>
+struct ExtiConflict
+{
+	static_assert(!Conflict, "EXTI line conflict: button index Button lost its line to button index Holder");
+	static constexpr bool ok = !Conflict;
+};
+
+constexpr uint8_t extiLine(uint16_t pin)
+{
+	uint8_t line = 0;
+	while(!(pin & (1u << line)))
+	{
+		line++;
+	}
+	return line;
+}
+
+} // namespace detail
+
+template<std::size_t N>
+constexpr ExtiPlan<N> planExti(const std::array<ExtiPin, N>& pins)
+{
+	ExtiPlan<N> plan{};
+	for(std::size_t line=0; line<16; line++)
+	{
+		plan.dispatch[line] = BUTTONS_NO_EXTI;
+	}
+	for(std::size_t i=0; i<N; i++)
+	{
+		plan.demote[i] = false;
+		if(pins[i].polled || pins[i].pin == 0)
+		{
+			continue;
+		}
+		// A pin mask of several bits can't be one button's line either
+		uint8_t line = detail::extiLine(pins[i].pin);
+		if((pins[i].pin & (pins[i].pin - 1)) != 0 || plan.dispatch[line] != BUTTONS_NO_EXTI)
+		{
+			if(plan.conflicts == 0)
+			{
+				plan.conflict = i;
+				plan.conflictHolder = (pins[i].pin & (pins[i].pin - 1)) != 0 ? i : plan.dispatch[line];
+			}
+			plan.demote[i] = true;
+			plan.conflicts++;
+			continue;
+		}
+		plan.dispatch[line] = static_cast<uint16_t>(i);
+		plan.lines |= static_cast<uint16_t>(1u << line);
+	}
+	return plan;
+}
+
+// Passes a HAL_GPIO_EXTI_Callback() pin to the button owning that line
+template<std::size_t N>
+inline void dispatchExti(const ExtiPlan<N>& plan, Button* buttons, uint16_t pin)
+{
+	if(pin == 0)
+	{
+		return;
+	}
+	uint16_t index = plan.dispatch[detail::extiLine(pin)];
+	if(index != BUTTONS_NO_EXTI)
+	{
+		buttons_ExtiGpioCallback(&buttons[index], ButtonEmulateNone);
+	}
+}
+
+#if FRAMEWORK_STM32CUBE
+// buttons_InitGroup() for the table the plan was made from. A table of another length
+// doesn't compile. Returns false, with the group initialised all the same, if the table
+// gives an EXTI line to another button than the plan does
+template<std::size_t N>
+inline bool initGroup(ButtonGroup* group, Button* buttons, const ButtonDesc (&table)[N], const ExtiPlan<N>& plan)
+{
+	buttons_InitGroup(group, buttons, N, table);
+	for(std::size_t line=0; line<16; line++)
+	{
+		if(group->extiButtons[line] != plan.dispatch[line])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+#endif
+
+} // namespace buttons
+
+#endif /* BUTTONS_EXTI_HPP_ */
@@ -0,0 +1,55 @@
+/*
+ * buttons_fsr.h
+ *
+ * Force sensitive resistor (FSR) pads.
+ *
+ * Each pad drives a ButtonVirtual button, so presses go through the same hold, double
+ * press, listener and poll machinery as switches. The pad reading is compared against a
+ * press threshold and a lower release threshold, the gap between them giving hysteresis
+ * instead of debounce timing. While pressed, changes of pressure raise PressureChanged
+ * events (aftertouch), limited to one per minInterval ms and only for changes of at
+ * least minDelta. The value is read with buttons_FsrGetPressure().
+ *
+ * Sample all pads with one ADC scan sequence into a DMA buffer (one sample per pad, in
+ * pad order), and pass the buffer from the conversion complete callback:
+ *
+	void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef* hadc)
+	{
+		buttons_FsrProcessAdc(pads, NUM_PADS, adcBuffer, HAL_GetTick());
+	}
+ *
+ * Any synthetic sample stream works the same way on a host.
+ */
+#ifndef BUTTONS_FSR_H_
+#define BUTTONS_FSR_H_
+
+#include "buttons.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+	// Assign in application
+	Button* button;
+	uint16_t pressThreshold;
+	uint16_t releaseThreshold;		// below pressThreshold
+	uint16_t minDelta;
+	uint16_t minInterval;			// ms
+	// Private
+	volatile uint16_t pressure;
+	uint16_t lastReported;
+	uint32_t lastReportTime;
+	uint8_t pressed;
+} ButtonFsr;
+
+void buttons_FsrInit(ButtonFsr* pad);
+void buttons_FsrProcessAdc(ButtonFsr* pads, uint16_t numPads, const uint16_t* samples, uint32_t timestamp);
+uint16_t buttons_FsrGetPressure(ButtonFsr* pad);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BUTTONS_FSR_H_ */
@@ -0,0 +1,72 @@
+/*
+ * buttons_hid.h
+ *
+ * USB HID report generation from button states.
+ *
+ * Rather than updating a report from every handler call, the report is built in one
+ * pass from the pressed state of the mapped buttons, and only when an edge has been
+ * accepted since the last build. Call buttons_HidBuildReport() when the host polls
+ * the IN endpoint (or on SOF), and send the report only if it returns TRUE:
+ *
+	if(buttons_HidBuildReport(&hid, report))
+	{
+		USBD_HID_SendReport(&hUsbDevice, report, sizeof(report));
+	}
+ *
+ * Mappings are either a bit in the report (gamepad buttons, keyboard modifiers),
+ * or a keycode placed in the next free slot of the keyboard key array.
+ * If more keys are pressed than there are slots, every slot reports ErrorRollOver.
+ *
+ * buttons_HidInit() checks the table against the report length and returns FALSE if
+ * anything falls outside it. Bad bit mappings are then skipped, and the key array is
+ * cut short at the end of the report.
+ */
+#ifndef BUTTONS_HID_H_
+#define BUTTONS_HID_H_
+
+#include "buttons.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BUTTONS_HID_ERROR_ROLLOVER 0x01
+
+typedef enum
+{
+	ButtonHidBit,		// sets bit 'value' of report byte 'reportByte'
+	ButtonHidKey		// places keycode 'value' in the key array
+} ButtonHidType;
+
+typedef struct
+{
+	uint16_t button;	// index of the button within the group
+	ButtonHidType type;
+	uint8_t reportByte;
+	uint8_t value;
+} ButtonHidMapping;
+
+typedef struct
+{
+	// Assign in application
+	ButtonGroup* group;
+	const ButtonHidMapping* mappings;	// may live in flash
+	uint16_t numMappings;
+	uint8_t reportLength;
+	uint8_t keyArrayStart;				// first byte of the key array (2 for a boot keyboard)
+	uint8_t keyArrayLength;				// number of key slots (6 for a boot keyboard)
+	// Private
+	uint32_t lastEpoch;
+	uint32_t lastGroupEpoch;			// injected edges only bump the group's epoch
+	uint8_t keySlots;					// keyArrayLength, cut to fit the report
+	uint8_t valid;
+} ButtonHid;
+
+uint8_t buttons_HidInit(ButtonHid* hid);
+uint8_t buttons_HidBuildReport(ButtonHid* hid, uint8_t* report);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BUTTONS_HID_H_ */
@@ -0,0 +1,119 @@
+/*
+ * buttons_link.h
+ *
+ * Inter-MCU button event link.
+ *
+ * A daughterboard running this library forwards its button events to the main MCU
+ * over a UART. Events are batched into frames:
+ *
+ *	SYNC | seq | count | count x (button, state) | crc16 lo | crc16 hi
+ *
+ * The CRC is CRC-16/CCITT-FALSE over seq, count and the event bytes.
+ * seq increments per frame so the receiver can count lost frames.
+ *
+ * Sending side:
+ * Either queue events from handlers with buttons_LinkQueueEvent(), or call
+ * buttons_LinkPoll() in place of buttons_TriggerPoll() to forward every pending event
+ * of a group. Then call buttons_LinkService() to start a transmission.
+ * On STM32Cube this uses HAL_UART_Transmit_DMA(); call buttons_LinkTxComplete() from
+ * HAL_UART_TxCpltCallback(). Other frameworks can call buttons_LinkBuildFrame() and
+ * write the frame themselves.
+ *
+ * Receiving side:
+ * Received events are queued, and buttons_LinkDispatch() applies them in order to the
+ * matching buttons of the link's group (usually ButtonVirtual mirrors) and dispatches
+ * them like local events. Call it from the main loop in place of buttons_GroupTriggerPoll()
+ * for that group. Each event is dispatched before the next one for the same button is
+ * applied, so a press and release batched into one frame are both delivered.
+ * On STM32Cube call buttons_LinkStartReceive() once, and buttons_LinkRxEvent() from
+ * HAL_UARTEx_RxEventCallback() (DMA with idle line detection). Half transfer callbacks
+ * are fine, only the bytes not yet parsed are passed on.
+ * Otherwise pass received bytes to buttons_LinkParse(). Frames may be split across or
+ * packed into any number of calls, so any byte stream (eg. a pty on a host, see tools/link_test.c) works.
+ * Every event is forwarded, including HeldRepeat, HoldProgress and PressureChanged
+ * (the pressure value itself stays on the sending side).
+ * A corrupted frame is rescanned from its second byte, so a stray sync byte can't hide
+ * a real frame that follows it.
+ */
+#ifndef BUTTONS_LINK_H_
+#define BUTTONS_LINK_H_
+
+#include "buttons.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BUTTONS_LINK_SYNC 0xB5
+
+// Number of events that can wait for transmission
+#ifndef BUTTONS_LINK_QUEUE_SIZE
+#define BUTTONS_LINK_QUEUE_SIZE 32
+#endif
+// Maximum number of events batched into a single frame
+#ifndef BUTTONS_LINK_MAX_EVENTS
+#define BUTTONS_LINK_MAX_EVENTS 16
+#endif
+// DMA receive buffer size
+#ifndef BUTTONS_LINK_RX_SIZE
+#define BUTTONS_LINK_RX_SIZE 64
+#endif
+
+#define BUTTONS_LINK_FRAME_SIZE (5 + 2*BUTTONS_LINK_MAX_EVENTS)
+
+typedef struct
+{
+	uint8_t button;
+	uint8_t state;
+} ButtonLinkEvent;
+
+typedef struct
+{
+	// Assign in application
+#if FRAMEWORK_STM32CUBE
+	UART_HandleTypeDef* uart;
+#endif
+	// Private
+	ButtonGroup* group;
+	ButtonLinkEvent txQueue[BUTTONS_LINK_QUEUE_SIZE];
+	volatile uint16_t txHead;
+	volatile uint16_t txTail;
+	uint8_t txSeq;
+	volatile uint8_t txBusy;
+	uint8_t txFrame[BUTTONS_LINK_FRAME_SIZE];
+	uint8_t rxFrame[BUTTONS_LINK_FRAME_SIZE];
+	uint16_t rxIndex;
+	uint8_t rxSeq;
+	uint8_t rxSynced;
+	ButtonLinkEvent rxQueue[BUTTONS_LINK_QUEUE_SIZE];
+	volatile uint16_t rxHead;
+	volatile uint16_t rxTail;
+#if FRAMEWORK_STM32CUBE
+	uint8_t rxBuffer[BUTTONS_LINK_RX_SIZE];
+	uint16_t rxParsed;		// bytes of rxBuffer already parsed in the current receive
+#endif
+	// Statistics
+	uint32_t txDropped;		// events that didn't fit in the queue
+	uint32_t rxDropped;		// received events that didn't fit in the queue
+	uint32_t rxLost;			// frames missing according to the sequence numbers
+	uint32_t rxCrcErrors;
+} ButtonLink;
+
+void buttons_LinkInit(ButtonLink* link, ButtonGroup* group);
+uint8_t buttons_LinkQueueEvent(ButtonLink* link, uint16_t button, ButtonState state);
+void buttons_LinkPoll(ButtonLink* link, ButtonGroup* group);
+uint16_t buttons_LinkBuildFrame(ButtonLink* link, uint8_t* frame);
+void buttons_LinkParse(ButtonLink* link, const uint8_t* data, uint16_t length);
+void buttons_LinkDispatch(ButtonLink* link);
+#if FRAMEWORK_STM32CUBE
+void buttons_LinkService(ButtonLink* link);
+void buttons_LinkTxComplete(ButtonLink* link);
+void buttons_LinkStartReceive(ButtonLink* link);
+void buttons_LinkRxEvent(ButtonLink* link, uint16_t size);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BUTTONS_LINK_H_ */
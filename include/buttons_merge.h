@@ -0,0 +1,67 @@
+/*
+ * buttons_merge.h
+ *
+ * Timestamp ordered merging of events from several sources.
+ *
+ * When buttons live in several groups or sources (local GPIO, expanders, remote links,
+ * virtual buttons), dispatching each source in turn delivers events grouped by source
+ * rather than in the order they happened. Instead, each source fills its own
+ * ButtonEventQueue (eg. with buttons_QueuePoll() in place of buttons_TriggerPoll()),
+ * and a ButtonMerger pops events from all queues in timestamp order.
+ *
+ * Sources may deliver late (eg. over a link), so an event is only released once it is
+ * older than the reorder window. A later event from a slow source that arrives within
+ * the window is still emitted in the correct order.
+ * Timestamps are ms and compared with wraparound.
+ */
+#ifndef BUTTONS_MERGE_H_
+#define BUTTONS_MERGE_H_
+
+#include "buttons.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Events per source queue
+#ifndef BUTTONS_EVENT_QUEUE_SIZE
+#define BUTTONS_EVENT_QUEUE_SIZE 16
+#endif
+
+typedef struct
+{
+	uint16_t button;		// index of the button within its source
+	uint8_t source;		// index of the source within the merger, set by buttons_MergerPop()
+	ButtonState state;
+	uint32_t timestamp;	// ms
+} ButtonEvent;
+
+// Single producer, single consumer event ring
+typedef struct
+{
+	ButtonEvent events[BUTTONS_EVENT_QUEUE_SIZE];
+	volatile uint16_t head;
+	volatile uint16_t tail;
+	uint32_t dropped;
+} ButtonEventQueue;
+
+typedef struct
+{
+	ButtonEventQueue** sources;
+	uint8_t numSources;
+	uint32_t window;			// reorder window in ms
+} ButtonMerger;
+
+void buttons_QueueInit(ButtonEventQueue* queue);
+uint8_t buttons_QueuePush(ButtonEventQueue* queue, uint16_t button, ButtonState state, uint32_t timestamp);
+uint8_t buttons_QueuePop(ButtonEventQueue* queue, ButtonEvent* event);
+void buttons_QueuePoll(ButtonGroup* group, ButtonEventQueue* queue);
+
+void buttons_MergerInit(ButtonMerger* merger, ButtonEventQueue** sources, uint8_t numSources, uint32_t window);
+uint8_t buttons_MergerPop(ButtonMerger* merger, uint32_t now, ButtonEvent* event);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BUTTONS_MERGE_H_ */
@@ -0,0 +1,93 @@
+/*
+ * buttons_midi.h
+ *
+ * MIDI output driven by button events.
+ *
+ * A binding table maps a button and event state to a channel voice message.
+ * Tables are grouped in a ButtonMidiBindingSet and published with
+ * buttons_MidiPublishBindings(), which swaps the set with a single pointer write, so
+ * bindings can be changed while playing. Each event is formatted with one consistent set.
+ * Call buttons_MidiEvent() with each event (eg. from a handler), which formats every
+ * matching binding into a lock-free transmit ring without blocking:
+ *
+	void FS1_HANDLER(ButtonState state)
+	{
+		buttons_MidiEvent(&midi, FS1_INDEX, state);
+	}
+ *
+ * DIN/UART output:
+ * Call buttons_MidiDrain() from the main loop. Everything queued since the last transfer
+ * is handed to the transmit callback in one go (eg. HAL_UART_Transmit_DMA()), so
+ * messages from simultaneous presses go out as one batch. Call buttons_MidiTxComplete()
+ * when the transfer finishes (eg. HAL_UART_TxCpltCallback()). A synchronous sink, such as
+ * a host test stand-in, may call it from within the transmit callback.
+ * With useRunningStatus set, repeated status bytes are omitted.
+ *
+ * USB-MIDI output:
+ * Set usb, and instead of buttons_MidiDrain() call buttons_MidiBuildUsbPackets() to convert
+ * queued messages into 4 byte USB-MIDI event packets for a single bulk IN transfer. USB-MIDI
+ * always carries the status byte, so messages are queued whole and running status is neither
+ * used nor tracked for it.
+ *
+ * tools/midi_test.c checks both outputs on a host with a byte sink in place of the UART.
+ */
+#ifndef BUTTONS_MIDI_H_
+#define BUTTONS_MIDI_H_
+
+#include "buttons.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Size of the transmit ring in bytes
+#ifndef BUTTONS_MIDI_RING_SIZE
+#define BUTTONS_MIDI_RING_SIZE 128
+#endif
+
+typedef struct
+{
+	uint16_t button;		// index of the button the application passes to buttons_MidiEvent()
+	ButtonState state;	// event that triggers the message
+	uint8_t status;		// channel voice status byte (0x80 - 0xEF)
+	uint8_t data1;
+	uint8_t data2;			// ignored for program change and channel pressure
+} ButtonMidiBinding;
+
+typedef struct
+{
+	const ButtonMidiBinding* bindings;		// may live in flash
+	uint16_t numBindings;
+} ButtonMidiBindingSet;
+
+typedef struct
+{
+	// Assign in application
+	uint8_t (*transmit)(const uint8_t* data, uint16_t length);	// start a transfer, returns FALSE if it couldn't
+	uint8_t useRunningStatus;					// DIN/UART output only
+	uint8_t usb;								// drained with buttons_MidiBuildUsbPackets()
+	uint8_t cable;								// USB-MIDI cable number
+	// Private
+	const ButtonMidiBindingSet* volatile bindingSet;
+	uint8_t ring[BUTTONS_MIDI_RING_SIZE];
+	volatile uint16_t head;
+	volatile uint16_t tail;
+	volatile uint16_t inFlight;
+	volatile uint8_t txBusy;
+	uint8_t runningStatus;
+	uint32_t dropped;							// messages that didn't fit in the ring
+} ButtonMidi;
+
+void buttons_MidiInit(ButtonMidi* midi);
+const ButtonMidiBindingSet* buttons_MidiPublishBindings(ButtonMidi* midi, const ButtonMidiBindingSet* bindingSet);
+uint16_t buttons_MidiEvent(ButtonMidi* midi, uint16_t button, ButtonState state);
+uint8_t buttons_MidiSend(ButtonMidi* midi, uint8_t status, uint8_t data1, uint8_t data2);
+void buttons_MidiDrain(ButtonMidi* midi);
+void buttons_MidiTxComplete(ButtonMidi* midi);
+uint16_t buttons_MidiBuildUsbPackets(ButtonMidi* midi, uint8_t* packets, uint16_t maxPackets);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BUTTONS_MIDI_H_ */
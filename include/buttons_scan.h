@@ -0,0 +1,55 @@
+/*
+ * buttons_scan.h
+ *
+ * Bit-parallel debounce of polled input ports.
+ *
+ * For many buttons read as whole port words (GPIO IDR, shift register chains, key
+ * matrix rows), debouncing each pin through its own Button is wasteful. Here one 32 bit
+ * word holds a lane per pin and a 2 bit vertical counter per lane is updated with a few
+ * logic operations for all 32 pins at once. A lane changes its debounced level after
+ * BUTTONS_SCAN_SAMPLES (4) consecutive samples at the new level, so the debounce time is
+ * four scan periods. Only lanes that changed then cost anything: each press or release
+ * is passed to the lane's button with buttons_VirtualEdge(), so hold, double press,
+ * listeners and polling work as for any other button.
+ *
+ * Call at a fixed rate, eg. from a 2 ms timer:
+ *
+	buttons_ScanProcess(&portA, GPIOA->IDR, HAL_GetTick());
+ *
+ * Several ports are simply several ButtonScanPort, the same code runs unchanged on a
+ * host with synthetic sample words. For very large simulations, tools/scan_simd has a
+ * bit-exact AVX2/NEON form of the same counter.
+ */
+#ifndef BUTTONS_SCAN_H_
+#define BUTTONS_SCAN_H_
+
+#include "buttons.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BUTTONS_SCAN_LANES		32
+#define BUTTONS_SCAN_SAMPLES	4
+
+typedef struct
+{
+	// Assign in application
+	Button** buttons;				// BUTTONS_SCAN_LANES entries indexed by bit, NULL for unused bits
+	uint32_t laneMask;				// bits to debounce
+	uint32_t activeLowMask;			// bits that read 0 when pressed
+	// Private
+	uint32_t counter0;
+	uint32_t counter1;
+	uint32_t state;					// debounced, 1 = pressed
+} ButtonScanPort;
+
+void buttons_ScanInit(ButtonScanPort* port);
+uint32_t buttons_ScanProcess(ButtonScanPort* port, uint32_t sample, uint32_t timestamp);
+uint32_t buttons_ScanGetState(ButtonScanPort* port);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BUTTONS_SCAN_H_ */
@@ -0,0 +1,132 @@
+/*
+ * buttons_trace.h
+ *
+ * Non-blocking edge and event trace stream.
+ *
+ * With BUTTONS_TRACE 1, buttons_TraceInit() hooks the library's trace callback and
+ * records every accepted edge, rejected (bounced) edge and dispatched event into a
+ * ring buffer. Recording only copies 8 bytes with the recording core's interrupts masked
+ * for those few instructions. It takes no lock, so it never waits, whatever the state of
+ * the output. On multi-core parts (ESP32) each core records into its own ring, and the
+ * rings are merged in timestamp order when drained. When a ring is full, records are
+ * dropped and counted, and the count is sent in the stream.
+ *
+ * Records are sent as 8 bytes each:
+ *
+ *	SYNC | type | button | value | timestamp (4 bytes, little endian)
+ *
+ * type is a ButtonTraceType, button the index into the sink's button array (0xFF for
+ * buttons outside it), value the edge level (1 = press) or ButtonState of an event,
+ * and timestamp the ms time (the group's virtual time for injected edges). A
+ * ButtonTraceDropped record carries the total number of dropped records in its timestamp,
+ * and is sent before the next records whenever that number has grown.
+ *
+ * Draining, from the main loop or a low priority context:
+ * On STM32Cube with the HAL UART driver, buttons_TraceServiceUart() starts a HAL_UART_Transmit_DMA() of the pending
+ * records; call buttons_TraceTxComplete() from HAL_UART_TxCpltCallback().
+ * Or, on cores with an ITM (Cortex-M3 and up), buttons_TraceServiceItm() writes to ITM
+ * stimulus port 0 (SWO) only while the port is ready, and carries on from where it stopped
+ * on the next call.
+ * Elsewhere, buttons_TraceBuild() fills a buffer to send by any means.
+ * tools/trace_decode.c prints a captured stream, from a file or a serial port.
+ *
+ * Records are written with the local core's interrupts masked, restoring the previous
+ * mask afterwards, on STM32Cube and on Arduino AVR, ARM, ESP32 and ESP8266 cores. On other
+ * cores define BUTTONS_TRACE_LOCK() and BUTTONS_TRACE_UNLOCK() to do the same, and, with
+ * more than one core recording, BUTTONS_TRACE_CORES and BUTTONS_TRACE_CORE() (the index
+ * of the calling core, read after the lock).
+ */
+#ifndef BUTTONS_TRACE_H_
+#define BUTTONS_TRACE_H_
+
+#include "buttons.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BUTTONS_TRACE_SYNC 0xA7
+#define BUTTONS_TRACE_RECORD_SIZE 8
+
+// Number of records that can wait for output
+#ifndef BUTTONS_TRACE_QUEUE_SIZE
+#define BUTTONS_TRACE_QUEUE_SIZE 64
+#endif
+// Cores that record at the same time, each into its own queue
+#ifndef BUTTONS_TRACE_CORES
+#if FRAMEWORK_ARDUINO && defined(ARDUINO_ARCH_ESP32)
+#define BUTTONS_TRACE_CORES portNUM_PROCESSORS
+#else
+#define BUTTONS_TRACE_CORES 1
+#endif
+#endif
+// ITM is only on Cortex-M3 and up, Cortex-M0/M0+ parts have no SWO trace
+#if FRAMEWORK_STM32CUBE && defined(ITM)
+#define BUTTONS_TRACE_ITM 1
+#else
+#define BUTTONS_TRACE_ITM 0
+#endif
+// The UART drain needs the HAL UART driver
+#if FRAMEWORK_STM32CUBE && defined(HAL_UART_MODULE_ENABLED)
+#define BUTTONS_TRACE_UART 1
+#else
+#define BUTTONS_TRACE_UART 0
+#endif
+// Maximum number of records sent in one transfer
+#ifndef BUTTONS_TRACE_MAX_RECORDS
+#define BUTTONS_TRACE_MAX_RECORDS 16
+#endif
+
+typedef struct
+{
+	uint8_t type;
+	uint8_t button;
+	uint8_t value;
+	uint32_t timestamp;
+} ButtonTraceRecord;
+
+// Records of one core, written by that core only
+typedef struct
+{
+	ButtonTraceRecord queue[BUTTONS_TRACE_QUEUE_SIZE];
+	volatile uint16_t head;
+	volatile uint16_t tail;
+	volatile uint32_t dropped;		// records that didn't fit in the queue
+} ButtonTraceQueue;
+
+typedef struct
+{
+	// Assign in application
+#if BUTTONS_TRACE_UART
+	UART_HandleTypeDef* uart;
+#endif
+	// Private
+	Button* buttons;
+	uint16_t numButtons;
+	ButtonTraceQueue queues[BUTTONS_TRACE_CORES];
+	volatile uint8_t txBusy;
+	uint8_t txFrame[BUTTONS_TRACE_RECORD_SIZE * (BUTTONS_TRACE_MAX_RECORDS + 1)];
+	uint16_t txIndex;
+	uint16_t txLength;
+	uint32_t reportedDropped;
+} ButtonTraceSink;
+
+#if BUTTONS_TRACE
+void buttons_TraceInit(ButtonTraceSink* sink, Button* buttons, uint16_t numButtons);
+void buttons_TraceRecord(ButtonTraceSink* sink, Button* button, ButtonTraceType type, uint8_t value, uint32_t timestamp);
+uint16_t buttons_TraceBuild(ButtonTraceSink* sink, uint8_t* buffer, uint16_t size);
+uint32_t buttons_TraceGetDropped(ButtonTraceSink* sink);
+#if BUTTONS_TRACE_UART
+void buttons_TraceServiceUart(ButtonTraceSink* sink);
+void buttons_TraceTxComplete(ButtonTraceSink* sink);
+#endif
+#if BUTTONS_TRACE_ITM
+void buttons_TraceServiceItm(ButtonTraceSink* sink);
+#endif
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BUTTONS_TRACE_H_ */
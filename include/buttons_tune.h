@@ -0,0 +1,91 @@
+/*
+ * buttons_tune.h
+ *
+ * Debounce timing advisor over recorded edge traces.
+ *
+ * Each trace is the ordered raw edges of one switch (ButtonEdge with button 0, eg. the
+ * accepted and rejected edges of a buttons_trace.h capture), along with the times the user
+ * really pressed it: the first contact of each press, and whether it was meant as the second
+ * press of a double press. buttons_TuneEvaluate() replays every trace through a scratch
+ * button in its own ButtonGroup with a candidate ButtonTimingProfile, and classifies each
+ * Pressed/DoublePressed event it produces against those press times. A press within
+ * BUTTONS_TUNE_MATCH_TIME after the next real press matches it, and its delay is the latency.
+ * Presses matching nothing are false (bounce that got through), real presses matched by
+ * nothing are missed (swallowed by a window), and a matched press of the wrong kind is a
+ * double press error. Released, DoublePressReleased and HeldReleased events while a real
+ * press is still down are false releases: bounce that let go of the press early, after which
+ * the real release is lost.
+ *
+ * Presses are reported on their first accepted edge, so latency comes from windows that
+ * lock out the first contact of a press. buttons_TuneParetoFront() marks the candidates no
+ * other candidate beats on false events (presses and releases), missed presses and mean
+ * latency together, keeping only the first of candidates with the same results, and
+ * buttons_TuneSelect() picks the one with the fewest errors, then the lowest latency, then
+ * the shortest windows. To tune several profiles, run it once per profile with traces
+ * recorded from buttons of that profile. tools/tune_advisor.c reads trace captures and runs the grid
+ * on all cores.
+ *
+ * Replay only writes to the scratch button and its group (injected edges neither trace nor
+ * bump the global state epoch), so it doesn't disturb the live buttons, and candidates may be
+ * evaluated on separate threads, each with its own scratch button.
+ */
+#ifndef BUTTONS_TUNE_H_
+#define BUTTONS_TUNE_H_
+
+#include "buttons.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ms after a real press within which a produced press counts as that press
+#ifndef BUTTONS_TUNE_MATCH_TIME
+#define BUTTONS_TUNE_MATCH_TIME 100
+#endif
+
+// doublePress value of a real press whose kind isn't known, so it isn't scored
+#define BUTTONS_TUNE_ANY_PRESS 0xFF
+
+typedef struct
+{
+	uint32_t timestamp;					// ms of the first contact
+	uint32_t duration;					// ms from the first contact to that of the release, 0 if unknown
+	uint8_t doublePress;				// 1 for the second press of a double press, or BUTTONS_TUNE_ANY_PRESS
+} ButtonTunePress;
+
+typedef struct
+{
+	const ButtonEdge* edges;			// raw edges of one switch, button 0
+	size_t numEdges;
+	const ButtonTunePress* presses;		// real presses, in time order
+	size_t numPresses;
+} ButtonTrace;
+
+typedef struct
+{
+	uint32_t presses;					// Pressed and DoublePressed events
+	uint32_t falsePresses;				// presses matching no real press
+	uint32_t missedPresses;				// real presses matched by no press
+	uint32_t doublePressErrors;			// matched presses of the wrong kind
+	uint32_t falseReleases;				// releases while a real press is still down
+	uint32_t rejectedEdges;				// edges swallowed by the debounce windows
+	uint32_t matchedPresses;
+	uint64_t latencyTotal;				// ms from real to produced press, over matched presses
+	uint32_t latencyMax;
+} ButtonTuneResult;
+
+void buttons_TuneEvaluate(const ButtonTimingProfile* candidate, const ButtonTrace* traces, uint16_t numTraces,
+							Button* scratch, ButtonTuneResult* result);
+uint16_t buttons_TuneRecommend(const ButtonTimingProfile* candidates, uint16_t numCandidates,
+							const ButtonTrace* traces, uint16_t numTraces,
+							Button* scratch, ButtonTuneResult* results);
+uint16_t buttons_TuneSelect(const ButtonTimingProfile* candidates, const ButtonTuneResult* results, uint16_t numCandidates);
+uint16_t buttons_TuneParetoFront(const ButtonTuneResult* results, uint16_t numCandidates, uint8_t* front);
+uint32_t buttons_TuneErrors(const ButtonTuneResult* result);
+uint32_t buttons_TuneMeanLatency(const ButtonTuneResult* result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BUTTONS_TUNE_H_ */
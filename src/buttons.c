@@ -17,6 +17,46 @@ extern "C" {
 #define FALSE	0
 #define CLEAR 0
 
+// Maximum number of GPIO ports gathered by buttons_InitGroup()
+#define BUTTONS_MAX_PORTS 11
+
+// Cycle count instrumentation of the public entry points, compiled out unless BUTTONS_PROFILE
+#if BUTTONS_PROFILE
+#define PROFILE_START() uint32_t profileStart = buttons_GetCycles()
+#define PROFILE_END(point) buttons_ProfileRecord(point, profileStart, NULL)
+// Snapshot of the state machine inputs, kept with the maximum so the worst path can be replayed
+#define PROFILE_SNAPSHOT(button, edge, tick) ButtonProfileInput profileInput = \
+	{(button)->lastState, (button)->timerTriggered, (edge), (tick) - (button)->lastTime}
+#define PROFILE_END_SNAPSHOT(point) buttons_ProfileRecord(point, profileStart, &profileInput)
+#else
+#define PROFILE_START()
+#define PROFILE_END(point)
+#define PROFILE_SNAPSHOT(button, edge, tick)
+#define PROFILE_END_SNAPSHOT(point)
+#endif
+
+// The DWT cycle counter only exists on Cortex-M3 and above (not on the M0+ of STM32G0)
+#if BUTTONS_PROFILE && FRAMEWORK_STM32CUBE && defined(DWT) && defined(CoreDebug)
+#define BUTTONS_DWT_CYCLES 1
+#else
+#define BUTTONS_DWT_CYCLES 0
+#endif
+
+// Edge and event tracing, compiled out unless BUTTONS_TRACE
+#if BUTTONS_TRACE
+#define TRACE(button, type, value, timestamp) \
+	do { if(traceCallback != NULL) traceCallback(button, type, value, timestamp); } while(0)
+#else
+#define TRACE(button, type, value, timestamp)
+#endif
+
+// Number of hold timer periods per hold
+#if BUTTON_HOLD_PROGRESS_STEPS > 1
+#define BUTTON_HOLD_STEPS BUTTON_HOLD_PROGRESS_STEPS
+#else
+#define BUTTON_HOLD_STEPS 1
+#endif
+
 volatile uint8_t debounceFail = 0;
 
 /* For accurate button hold fundtionality, the main application must configure a timer,
@@ -39,10 +79,74 @@ uint32_t (*timerGetCountCallback)(void) = NULL;
 uint8_t timerConfigured = FALSE;
 
 uint16_t buttonHoldTime;
+#if BUTTON_HOLD_PROGRESS_STEPS > 1
+volatile uint8_t holdStep = 0;
+#endif
+
+// Per button timing is looked up by the button's profile index in the active configuration.
+// The default configuration has a single profile reproducing the global macros
+const ButtonTimingProfile defaultTimingProfile[1] =
+{
+	{DEBOUNCE_LOW_TO_HIGH, DEBOUNCE_HIGH_TO_LOW, DOUBLE_PRESS_TIME, 0}
+};
+const ButtonConfig defaultConfig = {.profiles = defaultTimingProfile, .numProfiles = 1};
+#if BUTTONS_VELOCITY
+uint32_t (*microsecondCallback)(void) = NULL;
+#endif
+#if BUTTONS_TRACE
+void (*traceCallback)(Button* button, ButtonTraceType type, uint8_t value, uint32_t timestamp) = NULL;
+#endif
+#if BUTTONS_PROFILE
+ButtonProfileStats profileStats[ButtonProfileCount];
+uint32_t (*cycleCounterCallback)(void) = NULL;
+#endif
+
+// Replaced as a whole by a single pointer write, so readers always see one consistent set
+const ButtonConfig* volatile activeConfig = &defaultConfig;
+
+// Incremented on every accepted edge so consumers of the pressed state (eg. HID reports)
+// can tell cheaply whether anything changed since they last looked
+volatile uint32_t stateEpoch = 0;
+
+#if BUTTONS_AUDIO_CLOCK
+ButtonAudioClock* audioClock = NULL;
+#endif
 
 //-------------- PRIVATE FUNCTION PROTOTYPES --------------//
 uint8_t buttons_GetPinState(Button* button);
+void buttons_ConfigureGpio(const ButtonDesc* table, uint16_t numButtons, uint8_t interrupts);
+void buttons_ProcessEdge(ButtonGroup* group, Button* button, uint8_t interruptState, uint32_t tickTime);
+void buttons_PollButtons(ButtonGroup* group, Button* buttons, uint16_t numButtons);
+void buttons_DispatchButton(ButtonGroup* group, Button* button);
+void buttons_Dispatch(ButtonGroup* group, Button* button, ButtonState state);
+void buttons_NotifyListeners(ButtonListener** list, Button* button, ButtonState state, uint32_t dispatch);
+void buttons_InsertListener(ButtonListener** list, ButtonListener* listener, uint32_t dispatch);
+void buttons_UnlinkListener(ButtonListener** list, ButtonListener* listener);
+void buttons_ApplyHold(ButtonGroup* group, Button* buttons, uint16_t numButtons);
+void buttons_ApplyHoldProgress(ButtonGroup* group, Button* buttons, uint16_t numButtons, uint8_t step);
+const ButtonTimingProfile* buttons_GetTiming(const ButtonConfig* config, Button* button);
+uint8_t buttons_HoldTimerAvailable(ButtonGroup* group, uint16_t holdTime);
+void buttons_StartHoldTimer(ButtonGroup* group, uint32_t tickTime, uint16_t holdTime);
+void buttons_StopHoldTimer(ButtonGroup* group);
 void buttons_ResetTimerCounter();
+#if BUTTONS_TRACE
+uint32_t buttons_TraceTime(ButtonGroup* group);
+#endif
+#if BUTTONS_TELEMETRY
+void buttons_TelemetryEvent(Button* button, ButtonState state);
+uint16_t buttons_TelemetryFold(uint16_t trend, uint16_t bounce);
+uint8_t buttons_TelemetryOverWindow(uint16_t trend, uint16_t window);
+#endif
+#if BUTTONS_PROFILE
+uint32_t buttons_GetCycles(void);
+void buttons_ProfileRecord(ButtonProfilePoint point, uint32_t start, const ButtonProfileInput* input);
+#endif
+#if BUTTONS_VELOCITY
+uint32_t buttons_GetMicroseconds(void);
+#endif
+#if BUTTONS_AUDIO_CLOCK
+uint32_t buttons_AudioEdgeFrame(ButtonAudioClock* clock, uint32_t tickTime);
+#endif
 
 
 //-------------- PUBLIC FUNCTIONS --------------//
@@ -56,6 +160,20 @@ void buttons_Init(Button* button)
 
 	button->accelerationThreshold = BUTTON_ACCELERATION_THRESHOLD;
 	button->accelerationCounter = 0;
+	button->listeners = NULL;
+	button->dispatchCount = 0;
+	button->pressDuration = 0;
+	button->holdProgress = 0;
+	button->holdProgressTrigger = FALSE;
+	button->pressureTrigger = FALSE;
+#if BUTTONS_TELEMETRY
+	button->actuations = 0;
+	button->heldTime = 0;
+	button->bounceLowToHigh = 0;
+	button->bounceHighToLow = 0;
+	button->bounceTrendLowToHigh = 0;
+	button->bounceTrendHighToLow = 0;
+#endif
 }
 
 #if FRAMEWORK_ARDUINO
@@ -89,6 +207,12 @@ void buttons_AssignTimerGetCounterCallback(uint32_t (*callback)(void))
     }
 }
 
+void buttons_SetHoldTime(uint16_t time)
+{
+	// The application owns the timer period, this only informs the virtual clock used for injected edges
+	buttonHoldTime = time;
+}
+
 #elif FRAMEWORK_STM32CUBE
 void buttons_SetHoldTimer(TIM_HandleTypeDef *timHandle, uint16_t time)
 {
@@ -106,6 +230,7 @@ void buttons_SetHoldTimer(TIM_HandleTypeDef *timHandle, uint16_t time)
 	uint32_t cpuFreq = HAL_RCC_GetSysClockFreq();
 	holdTim->Init.Prescaler = cpuFreq / 10000;				// This assumes the clock is in the MHz range
 	holdTim->Init.Period = time*10;
+	buttonHoldTime = time;
 	timerConfigured = TRUE;
 
 	// Update timer instance with new timing values and clear the interrupt flag to prevent initial mis-fire (bug found previously)
@@ -123,27 +248,31 @@ void buttons_SetHoldTimer(TIM_HandleTypeDef *timHandle, uint16_t time)
 
 void buttons_TriggerPoll(Button* buttons, uint16_t numButtons)
 {
-	// Find which button has a new event, execute the callback handler, then clear the state when finished
-	// Note that the full loop is allowed to continue in case multiple interrupts were fired before polling
-	for(int i=0; i<numButtons; i++)
-	{
-		if(buttons[i].state != Cleared)
-		{
-			ButtonState tempState = buttons[i].state;
-			buttons[i].state = Cleared;
-			if(buttons[i].handler != NULL)
-				buttons[i].handler(tempState);
-		}
-		if(buttons[i].accelerationTrigger)
-		{
-			buttons[i].handler(HeldRepeat);
-			buttons[i].accelerationTrigger = FALSE;
-		}
-	}
+	PROFILE_START();
+	buttons_PollButtons(NULL, buttons, numButtons);
+	PROFILE_END(ButtonProfilePoll);
+}
+
+void buttons_GroupTriggerPoll(ButtonGroup* group)
+{
+	PROFILE_START();
+	buttons_PollButtons(group, group->buttons, group->numButtons);
+	PROFILE_END(ButtonProfilePoll);
 }
 
 void buttons_HoldTimerElapsed(Button* buttons, uint16_t numButtons)
 {
+	PROFILE_START();
+#if BUTTON_HOLD_PROGRESS_STEPS > 1
+	// The timer period is a fraction of the hold time, only the last step is the hold itself
+	if(++holdStep < BUTTON_HOLD_PROGRESS_STEPS)
+	{
+		buttons_ApplyHoldProgress(NULL, buttons, numButtons, holdStep);
+		PROFILE_END(ButtonProfileHoldTimer);
+		return;
+	}
+	holdStep = 0;
+#endif
 	if(timerConfigured)
 	{
 #if FRAMEWORK_STM32CUBE
@@ -153,28 +282,24 @@ void buttons_HoldTimerElapsed(Button* buttons, uint16_t numButtons)
 			timerStopCallback();
 #endif
 	}
-	// Check hold states for all the buttons before hold is actioned
-	// This ensures multiple holds are all captured before being actioned
-	for(int i=0; i<numButtons; i++)
-	{
-		// Check not only if the button has not been released, but if a timer event was triggered for that button
-		if((buttons[i].lastState == Pressed || buttons[i].lastState == DoublePressed) && buttons[i].timerTriggered)
-		{
-			buttons[i].state = Held;
-			buttons[i].lastState = Held;
-			buttons[i].timerTriggered = 0;
-		}
-	}
+	buttons_ApplyHold(NULL, buttons, numButtons);
+	PROFILE_END(ButtonProfileHoldTimer);
 }
 
 void buttons_ExtiGpioCallback(Button* button, ButtonEmulateAction emulateAction)
 {
+	PROFILE_START();
 	uint8_t interruptState = 0;
 	uint32_t tickTime;
 
 	// If the button press is a hardware pin interrupt event
 	if(emulateAction == ButtonEmulateNone)
 	{
+		// Virtual buttons have no pin to read, so only emulated actions are valid
+		if(button->source == ButtonVirtual)
+		{
+			return;
+		}
 		if(buttons_GetPinState(button) != 0)
 		{
 			// Check for physical logic state mode
@@ -216,10 +341,419 @@ void buttons_ExtiGpioCallback(Button* button, ButtonEmulateAction emulateAction)
 	#elif FRAMEWORK_ARDUINO
 	tickTime = millis();
 	#endif
-	// For a a new press event, the time since last release must be greater than the high to low debounce time
+	PROFILE_SNAPSHOT(button, interruptState, tickTime);
+	buttons_ProcessEdge(NULL, button, interruptState, tickTime);
+	PROFILE_END_SNAPSHOT(ButtonProfileExti);
+}
+
+#if BUTTONS_AUDIO_CLOCK
+void buttons_SetAudioClock(ButtonAudioClock* clock)
+{
+	clock->blockIndex = 0;
+	audioClock = clock;
+}
+
+void buttons_AudioBlockComplete(ButtonAudioClock* clock)
+{
+	clock->blockIndex++;
+}
+
+uint32_t buttons_AudioFrameNow(ButtonAudioClock* clock)
+{
+	uint32_t blockIndex;
+	uint16_t position;
+	// Re-read if a block completed between reading the index and the position
+	do
+	{
+		blockIndex = clock->blockIndex;
+		position = clock->getBlockPosition();
+	} while(blockIndex != clock->blockIndex);
+	return blockIndex * clock->blockSize + position;
+}
+
+int32_t buttons_AudioEventOffset(Button* button, uint32_t blockStartFrame)
+{
+	return (int32_t)(button->edgeFrame - blockStartFrame);
+}
+#endif
+
+#if BUTTONS_VELOCITY
+void buttons_AssignMicrosecondCallback(uint32_t (*callback)(void))
+{
+	microsecondCallback = callback;
+}
+
+void buttons_FirstContactCallback(Button* button)
+{
+	// Closing the first contact starts timing, opening it before the second contact abandons it
+	uint8_t pinState;
+#if FRAMEWORK_STM32CUBE
+	pinState = HAL_GPIO_ReadPin(button->firstContactPort, button->firstContactPin);
+#elif FRAMEWORK_ARDUINO
+	pinState = digitalRead(button->firstContactPin);
+#endif
+	if((pinState != 0) == (button->logicMode == ActiveHigh))
+	{
+		button->firstContactTime = buttons_GetMicroseconds();
+		button->firstContactValid = TRUE;
+	}
+	else
+	{
+		button->firstContactValid = FALSE;
+	}
+}
+
+uint8_t buttons_GetVelocity(Button* button)
+{
+	const ButtonVelocityCurve* curve = activeConfig->velocityCurve;
+	if(curve == NULL || curve->numPoints == 0)
+	{
+		return 127;
+	}
+	uint32_t delta = button->contactDelta;
+	if(delta <= curve->delta[0])
+	{
+		return curve->velocity[0];
+	}
+	for(int i=1; i<curve->numPoints; i++)
+	{
+		if(delta < curve->delta[i])
+		{
+			// Interpolate between the neighbouring points
+			int32_t v0 = curve->velocity[i-1];
+			int32_t v1 = curve->velocity[i];
+			uint32_t span = curve->delta[i] - curve->delta[i-1];
+			return (uint8_t)(v0 + (v1 - v0) * (int32_t)(delta - curve->delta[i-1]) / (int32_t)span);
+		}
+	}
+	return curve->velocity[curve->numPoints - 1];
+}
+#endif
+
+#if BUTTONS_TELEMETRY
+void buttons_GetTelemetry(Button* button, ButtonTelemetry* telemetry)
+{
+	telemetry->actuations = button->actuations;
+	telemetry->heldTime = button->heldTime;
+	telemetry->bounceLowToHigh = button->bounceTrendLowToHigh;
+	telemetry->bounceHighToLow = button->bounceTrendHighToLow;
+}
+
+void buttons_RestoreTelemetry(Button* button, const ButtonTelemetry* telemetry)
+{
+	button->actuations = telemetry->actuations;
+	button->heldTime = telemetry->heldTime;
+	button->bounceTrendLowToHigh = telemetry->bounceLowToHigh;
+	button->bounceTrendHighToLow = telemetry->bounceHighToLow;
+}
+
+uint8_t buttons_PersistTelemetry(Button* buttons, ButtonTelemetry* persisted, uint16_t numButtons, uint32_t minActuations,
+									void (*write)(const ButtonTelemetry* telemetry, uint16_t numButtons))
+{
+	// persisted holds what was last written, so the new presses since then need no extra state
+	uint32_t pending = 0;
+	for(int i=0; i<numButtons; i++)
+	{
+		pending += buttons[i].actuations - persisted[i].actuations;
+	}
+	if(pending == 0 || pending < minActuations)
+	{
+		return FALSE;
+	}
+	for(int i=0; i<numButtons; i++)
+	{
+		buttons_GetTelemetry(&buttons[i], &persisted[i]);
+	}
+	write(persisted, numButtons);
+	return TRUE;
+}
+
+uint8_t buttons_TelemetryWorn(Button* button)
+{
+	// Each window's bounce leaks through once it outlasts that window
+	const ButtonTimingProfile* timing = buttons_GetTiming(activeConfig, button);
+	return buttons_TelemetryOverWindow(button->bounceTrendLowToHigh, timing->debounceLowToHigh) ||
+			buttons_TelemetryOverWindow(button->bounceTrendHighToLow, timing->debounceHighToLow);
+}
+#endif
+
+#if BUTTONS_TRACE
+void buttons_AssignTraceCallback(void (*callback)(Button* button, ButtonTraceType type, uint8_t value, uint32_t timestamp))
+{
+	traceCallback = callback;
+}
+#endif
 
-	if((interruptState == 0 && (tickTime - button->lastTime) > DEBOUNCE_HIGH_TO_LOW) ||
-		(interruptState == 1 && (tickTime - button->lastTime) > DEBOUNCE_LOW_TO_HIGH))
+#if BUTTONS_PROFILE
+void buttons_AssignCycleCounterCallback(uint32_t (*callback)(void))
+{
+	cycleCounterCallback = callback;
+}
+
+void buttons_ProfileInit(void)
+{
+#if BUTTONS_DWT_CYCLES
+	// Enable the free running DWT cycle counter
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+	buttons_ProfileReset();
+}
+
+void buttons_ProfileReset(void)
+{
+	for(int i=0; i<ButtonProfileCount; i++)
+	{
+		profileStats[i].calls = 0;
+		profileStats[i].lastCycles = 0;
+		profileStats[i].maxCycles = 0;
+		profileStats[i].totalCycles = 0;
+		profileStats[i].worstInput = (ButtonProfileInput){Released, 0, 0, 0};
+	}
+}
+
+const ButtonProfileStats* buttons_GetProfileStats(ButtonProfilePoint point)
+{
+	return &profileStats[point];
+}
+#endif
+
+void buttons_InitGroup(ButtonGroup* group, Button* buttons, uint16_t numButtons, const ButtonDesc* table)
+{
+	group->buttons = buttons;
+	group->numButtons = numButtons;
+	group->virtualTime = 0;
+	group->virtualClock = FALSE;
+	group->holdStart = 0;
+	group->holdDuration = 0;
+	group->holdRunning = FALSE;
+	group->listeners = NULL;
+	group->config = NULL;
+	group->dispatchCount = 0;
+	group->debounceFails = 0;
+	group->stateEpoch = 0;
+	group->injecting = FALSE;
+
+	// Without a table the buttons are assumed to be assigned and initialised already.
+	// The pins start as plain inputs, so no edge can arrive before the buttons are seeded
+	// and the EXTI lookup is built
+	if(table != NULL)
+	{
+		buttons_ConfigureGpio(table, numButtons, FALSE);
+		for(int i=0; i<numButtons; i++)
+		{
+			Button* button = &buttons[i];
+			button->mode = table[i].mode;
+			button->logicMode = table[i].logicMode;
+			button->handler = table[i].handler;
+			button->pin = table[i].pin;
+#if FRAMEWORK_STM32CUBE
+			button->port = table[i].port;
+#endif
+			button->source = table[i].source;
+			button->profile = table[i].profile;
+			button->debounceBypass = table[i].debounceBypass;
+			buttons_Init(button);
+			button->timerTriggered = 0;
+			button->accelerationTrigger = FALSE;
+
+			// Seed from the pin so a switch held at boot produces neither a press nor its release
+			if(button->source == ButtonPhysical &&
+				(buttons_GetPinState(button) != 0) == (button->logicMode == ActiveHigh))
+			{
+				button->lastState = Pressed;
+			}
+		}
+	}
+
+#if FRAMEWORK_STM32CUBE
+	for(int line=0; line<16; line++)
+	{
+		group->extiButtons[line] = BUTTONS_NO_EXTI;
+	}
+	for(int i=0; i<numButtons; i++)
+	{
+		if(buttons[i].source == ButtonPhysical && buttons[i].pin != 0)
+		{
+			group->extiButtons[__builtin_ctz(buttons[i].pin)] = i;
+		}
+	}
+#endif
+
+	if(table != NULL)
+	{
+		buttons_ConfigureGpio(table, numButtons, TRUE);
+	}
+}
+
+#if FRAMEWORK_STM32CUBE
+void buttons_GroupExtiCallback(ButtonGroup* group, uint16_t pin)
+{
+	if(pin == 0)
+	{
+		return;
+	}
+	uint16_t index = group->extiButtons[__builtin_ctz(pin)];
+	if(index != BUTTONS_NO_EXTI)
+	{
+		buttons_ExtiGpioCallback(&group->buttons[index], ButtonEmulateNone);
+	}
+}
+#endif
+
+void buttons_AddGroupListener(ButtonGroup* group, ButtonListener* listener)
+{
+	buttons_InsertListener(&group->listeners, listener, group->dispatchCount);
+}
+
+void buttons_RemoveGroupListener(ButtonGroup* group, ButtonListener* listener)
+{
+	buttons_UnlinkListener(&group->listeners, listener);
+}
+
+void buttons_AddListener(Button* button, ButtonListener* listener)
+{
+	buttons_InsertListener(&button->listeners, listener, button->dispatchCount);
+}
+
+void buttons_RemoveListener(Button* button, ButtonListener* listener)
+{
+	buttons_UnlinkListener(&button->listeners, listener);
+}
+
+void buttons_VirtualEdge(Button* button, ButtonEmulateAction action, uint32_t timestamp)
+{
+	// Software sources already know the logical level and when it happened,
+	// so skip the pin read and tick lookup and go straight to the state machine
+	if(action == ButtonEmulatePress)
+	{
+		buttons_ProcessEdge(NULL, button, 0, timestamp);
+	}
+	else if(action == ButtonEmulateRelease)
+	{
+		buttons_ProcessEdge(NULL, button, 1, timestamp);
+	}
+}
+
+
+uint8_t buttons_IsPressed(Button* button)
+{
+	return button->lastState == Pressed || button->lastState == DoublePressed || button->lastState == Held;
+}
+
+uint32_t buttons_GetStateEpoch(void)
+{
+	return stateEpoch;
+}
+
+void buttons_BumpStateEpoch(void)
+{
+	stateEpoch++;
+}
+
+const ButtonConfig* buttons_PublishConfig(const ButtonConfig* config)
+{
+	const ButtonConfig* previous = activeConfig;
+	if(config == NULL || config->profiles == NULL || config->numProfiles == 0)
+	{
+		config = &defaultConfig;
+	}
+	// Make sure the table contents are visible before the pointer that leads to them
+	__sync_synchronize();
+	activeConfig = config;
+	return previous;
+}
+
+const ButtonConfig* buttons_GetConfig(void)
+{
+	return activeConfig;
+}
+
+void buttons_SetGroupConfig(ButtonGroup* group, const ButtonConfig* config)
+{
+	// Only applies to injected edges, which are handled against the group's own clock too
+	group->config = config;
+}
+
+uint32_t buttons_GetGroupDebounceFails(ButtonGroup* group)
+{
+	return group->debounceFails;
+}
+
+uint32_t buttons_GetGroupStateEpoch(ButtonGroup* group)
+{
+	return group->stateEpoch;
+}
+
+uint16_t buttons_GetHoldTime(Button* button)
+{
+	uint16_t holdTime = buttons_GetTiming(activeConfig, button)->holdTime;
+	return holdTime != 0 ? holdTime : buttonHoldTime;
+}
+
+void buttons_InjectEdges(ButtonGroup* group, const ButtonEdge* edges, size_t n)
+{
+	// Edges are applied in order against the group's virtual clock rather than the system tick.
+	// Each edge's resulting event is dispatched straight away so none are overwritten before a poll
+	uint8_t injecting = group->injecting;
+	group->injecting = TRUE;
+	for(size_t i=0; i<n; i++)
+	{
+		buttons_AdvanceVirtualTime(group, edges[i].timestamp);
+		if(edges[i].button >= group->numButtons)
+		{
+			continue;
+		}
+		Button* button = &group->buttons[edges[i].button];
+		buttons_ProcessEdge(group, button, edges[i].level ? 0 : 1, edges[i].timestamp);
+		buttons_DispatchButton(group, button);
+	}
+	group->injecting = injecting;
+}
+
+void buttons_AdvanceVirtualTime(ButtonGroup* group, uint32_t timestamp)
+{
+	// Fire the virtual hold timer steps that would have elapsed by this time
+	uint8_t injecting = group->injecting;
+	group->injecting = TRUE;
+	group->virtualClock = TRUE;
+	while(group->holdRunning &&
+			(timestamp - group->holdStart) >= (uint32_t)group->holdDuration * (group->holdStep + 1) / BUTTON_HOLD_STEPS)
+	{
+		// Hold events are dispatched at the virtual time the step elapsed
+		group->virtualTime = group->holdStart + (uint32_t)group->holdDuration * (group->holdStep + 1) / BUTTON_HOLD_STEPS;
+		if(++group->holdStep < BUTTON_HOLD_STEPS)
+		{
+			buttons_ApplyHoldProgress(group, group->buttons, group->numButtons, group->holdStep);
+		}
+		else
+		{
+			group->holdRunning = FALSE;
+			buttons_ApplyHold(group, group->buttons, group->numButtons);
+		}
+	}
+	group->virtualTime = timestamp;
+	group->injecting = injecting;
+}
+
+
+//-------------- PRIVATE FUNCTIONS --------------//
+/* Shared press/release state machine for hardware, emulated and virtual edges.
+ * interruptState is 0 for a press and 1 for a release, tickTime is the edge timestamp in ms
+ * group is NULL for real time edges (hardware hold timer), or the group whose virtual clock
+ * drives the hold logic for injected edges
+ */
+void buttons_ProcessEdge(ButtonGroup* group, Button* button, uint8_t interruptState, uint32_t tickTime)
+{
+	// Read the configuration once, so the whole edge is handled with one set of values
+	const ButtonConfig* config = (group != NULL && group->config != NULL) ? group->config : activeConfig;
+	const ButtonTimingProfile* timing = buttons_GetTiming(config, button);
+
+	// For a a new press event, the time since last release must be greater than the high to low debounce time
+	if(button->debounceBypass ||
+		(interruptState == 0 && (tickTime - button->lastTime) > timing->debounceHighToLow) ||
+		(interruptState == 1 && (tickTime - button->lastTime) > timing->debounceLowToHigh))
 	{
 		// NEW PRESS
 		// There is no need to check other conditions as time since release isn't important
@@ -229,17 +763,13 @@ void buttons_ExtiGpioCallback(Button* button, ButtonEmulateAction emulateAction)
 		{
 			// Check to see if the timer has already been started (aka. another switch is already being held)
 			// If it has, but the time since it was triggered is below the threshold, include that button in the timerTriggered flag
-			if(timerConfigured)
+			uint16_t holdTime = timing->holdTime != 0 ? timing->holdTime : buttonHoldTime;
+			if(buttons_HoldTimerAvailable(group, holdTime))
 			{
 				if(!button->timerTriggered)
 				{
 					button->timerTriggered = 1;
-					#if FRAMEWORK_STM32CUBE
-					HAL_TIM_Base_Start_IT(holdTim);
-					#elif FRAMEWORK_ARDUINO
-					if(timerStartCallback != NULL)
-						timerStartCallback();
-					#endif
+					buttons_StartHoldTimer(group, tickTime, holdTime);
 				}
 
 				// Check if another switch was pressed around the same time, and set it's timerTriggered flag too
@@ -251,8 +781,17 @@ void buttons_ExtiGpioCallback(Button* button, ButtonEmulateAction emulateAction)
 			}
 			
 			// Update states
+			button->holdProgress = 0;
+			button->pressEvent = TRUE;
+#if BUTTONS_TELEMETRY
+			button->actuations++;
+#endif
+#if BUTTONS_VELOCITY
+			button->contactDelta = button->firstContactValid ? buttons_GetMicroseconds() - button->firstContactTime : 0;
+			button->firstContactValid = FALSE;
+#endif
 			// Check the previous press time for a double press action
-			if((tickTime - button->lastTime < DOUBLE_PRESS_TIME) && button->lastTime > 0)
+			if((tickTime - button->lastTime < timing->doublePressTime) && button->lastTime > 0)
 			{
 				button->state = DoublePressed;
 				button->lastState = DoublePressed;
@@ -264,21 +803,21 @@ void buttons_ExtiGpioCallback(Button* button, ButtonEmulateAction emulateAction)
 			}
 		}
 
+		// RELEASE OF A SWITCH HELD AT BOOT
+		// It was seeded as pressed without reporting a press, so its release isn't reported either
+		else if(interruptState && button->lastState == Pressed && !button->pressEvent)
+		{
+			button->lastState = Released;
+		}
+
 		// NEW RELEASED //
 		else if(button->lastState == Pressed || button->lastState == DoublePressed || button->lastState == Held)
 		{
+			// lastTime still holds the press edge, as holds don't update it
+			button->pressDuration = tickTime - button->lastTime;
 			if(button->lastState == Pressed)
 			{
-				if(timerConfigured)
-				{
-					#if FRAMEWORK_STM32CUBE
-					HAL_TIM_Base_Stop_IT(holdTim);
-					buttons_ResetTimerCounter();
-					#elif FRAMEWORK_ARDUINO
-					if(timerStopCallback != NULL)
-						timerStopCallback();
-					#endif
-				}
+				buttons_StopHoldTimer(group);
 				button->state = Released;
 				button->lastState = Released;
 				button->timerTriggered = 0;
@@ -295,40 +834,501 @@ void buttons_ExtiGpioCallback(Button* button, ButtonEmulateAction emulateAction)
 			}
 			else if(button->lastState == DoublePressed)
 			{
-				if(timerConfigured)
-				{
-					#if FRAMEWORK_STM32CUBE
-					HAL_TIM_Base_Stop_IT(holdTim);
-					buttons_ResetTimerCounter();
-					#elif FRAMEWORK_ARDUINO
-					if(timerStopCallback != NULL)
-						timerStopCallback();
-					#endif
-				}
+				buttons_StopHoldTimer(group);
 				button->state = DoublePressReleased;
 				button->lastState = DoublePressReleased;
 				button->timerTriggered = 0;
 			}
 		}
 		button->lastTime = tickTime;
+#if BUTTONS_AUDIO_CLOCK
+		// Injected edges run on the group's virtual clock, which has no relation to the audio
+		if(audioClock != NULL && group == NULL)
+		{
+			button->edgeFrame = buttons_AudioEdgeFrame(audioClock, tickTime);
+		}
+#endif
+		// Injected edges stay within their group, so groups can run on separate threads
+		if(group != NULL)
+		{
+			group->stateEpoch++;
+		}
+		else
+		{
+			stateEpoch++;
+			TRACE(button, ButtonTraceEdge, !interruptState, tickTime);
+		}
 	}
 	else
 	{
-		debounceFail = 1;
+#if BUTTONS_TELEMETRY
+		// Rejected edges fall within the debounce window, so this fits the 16 bit field.
+		// A rejected release fell in debounceLowToHigh, a rejected press in debounceHighToLow
+		if(interruptState)
+		{
+			button->bounceLowToHigh = (uint16_t)(tickTime - button->lastTime);
+		}
+		else
+		{
+			button->bounceHighToLow = (uint16_t)(tickTime - button->lastTime);
+		}
+#endif
+		if(group != NULL)
+		{
+			group->debounceFails++;
+		}
+		else
+		{
+			debounceFail = 1;
+			TRACE(button, ButtonTraceRejected, !interruptState, tickTime);
+		}
 	}
 }
 
+void buttons_PollButtons(ButtonGroup* group, Button* buttons, uint16_t numButtons)
+{
+	// Find which button has a new event, execute the callback handler, then clear the state when finished
+	// Note that the full loop is allowed to continue in case multiple interrupts were fired before polling
+	for(int i=0; i<numButtons; i++)
+	{
+		buttons_DispatchButton(group, &buttons[i]);
+		if(buttons[i].accelerationTrigger)
+		{
+			buttons_TakeEvent(group, &buttons[i], HeldRepeat);
+			buttons_Dispatch(group, &buttons[i], HeldRepeat);
+		}
+		if(buttons[i].holdProgressTrigger)
+		{
+			buttons_TakeEvent(group, &buttons[i], HoldProgress);
+			buttons_Dispatch(group, &buttons[i], HoldProgress);
+		}
+		if(buttons[i].pressureTrigger)
+		{
+			buttons_TakeEvent(group, &buttons[i], PressureChanged);
+			buttons_Dispatch(group, &buttons[i], PressureChanged);
+		}
+	}
+}
+
+/* Clears a pending event and accounts for it (telemetry, trace), without calling anything.
+ * Used before each dispatch, and on its own by paths that forward events elsewhere
+ * (buttons_QueuePoll(), buttons_LinkPoll())
+ */
+void buttons_TakeEvent(ButtonGroup* group, Button* button, ButtonState state)
+{
+	if(state == HeldRepeat)
+	{
+		button->accelerationTrigger = FALSE;
+	}
+	else if(state == HoldProgress)
+	{
+		button->holdProgressTrigger = FALSE;
+	}
+	else if(state == PressureChanged)
+	{
+		button->pressureTrigger = FALSE;
+	}
+	else
+	{
+		button->state = Cleared;
+	}
+#if BUTTONS_TELEMETRY
+	buttons_TelemetryEvent(button, state);
+#endif
+#if BUTTONS_TRACE
+	if(group == NULL || !group->injecting)
+	{
+		TRACE(button, ButtonTraceEvent, state, buttons_TraceTime(group));
+	}
+#endif
+}
+
+void buttons_DispatchButton(ButtonGroup* group, Button* button)
+{
+	if(button->state != Cleared)
+	{
+		ButtonState tempState = button->state;
+		buttons_TakeEvent(group, button, tempState);
+		buttons_Dispatch(group, button, tempState);
+	}
+}
+
+void buttons_Dispatch(ButtonGroup* group, Button* button, ButtonState state)
+{
+	// Listeners added from within a callback are stamped with this dispatch and skipped.
+	// Each list owner keeps its own count, so groups don't share any dispatch state
+	uint32_t buttonDispatch = ++button->dispatchCount;
+	uint32_t groupDispatch = group != NULL ? ++group->dispatchCount : 0;
+
+	if(button->handler != NULL)
+		button->handler(state);
+	buttons_NotifyListeners(&button->listeners, button, state, buttonDispatch);
+	if(group != NULL)
+	{
+		buttons_NotifyListeners(&group->listeners, button, state, groupDispatch);
+	}
+}
+
+void buttons_NotifyListeners(ButtonListener** list, Button* button, ButtonState state, uint32_t dispatch)
+{
+	ButtonListener** link = list;
+	while(*link != NULL)
+	{
+		ButtonListener* listener = *link;
+		if(listener->addedDispatch == dispatch || !(listener->stateMask & BUTTON_STATE_MASK(state)))
+		{
+			link = &listener->next;
+		}
+		else if(listener->oneShot)
+		{
+			// Unlink first so the callback can wait again on the same button
+			*link = listener->next;
+			listener->callback(listener, button, state);
+		}
+		else
+		{
+			listener->callback(listener, button, state);
+			// Only step over the listener if it didn't remove itself
+			if(*link == listener)
+			{
+				link = &listener->next;
+			}
+		}
+	}
+}
+
+void buttons_InsertListener(ButtonListener** list, ButtonListener* listener, uint32_t dispatch)
+{
+	listener->addedDispatch = dispatch;
+	listener->next = *list;
+	*list = listener;
+}
+
+void buttons_UnlinkListener(ButtonListener** list, ButtonListener* listener)
+{
+	// The removed node keeps its next pointer, so a dispatch walk positioned on it can carry on
+	ButtonListener** link = list;
+	while(*link != NULL)
+	{
+		if(*link == listener)
+		{
+			*link = listener->next;
+			return;
+		}
+		link = &(*link)->next;
+	}
+}
+
+void buttons_ApplyHold(ButtonGroup* group, Button* buttons, uint16_t numButtons)
+{
+	// Check hold states for all the buttons before hold is actioned
+	// This ensures multiple holds are all captured before being actioned
+	for(int i=0; i<numButtons; i++)
+	{
+		// Check not only if the button has not been released, but if a timer event was triggered for that button
+		if((buttons[i].lastState == Pressed || buttons[i].lastState == DoublePressed) && buttons[i].timerTriggered)
+		{
+			buttons[i].state = Held;
+			buttons[i].lastState = Held;
+			buttons[i].timerTriggered = 0;
+			buttons[i].holdProgress = BUTTON_HOLD_STEPS;
+			buttons[i].holdProgressTrigger = FALSE;
+			// Injected edges are dispatched immediately, so the hold event must be too
+			if(group != NULL)
+			{
+				buttons_DispatchButton(group, &buttons[i]);
+			}
+		}
+	}
+}
+
+const ButtonTimingProfile* buttons_GetTiming(const ButtonConfig* config, Button* button)
+{
+	// A button may refer to a profile that a newly published table doesn't have
+	if(button->profile < config->numProfiles)
+	{
+		return &config->profiles[button->profile];
+	}
+	return &config->profiles[0];
+}
+
+void buttons_ApplyHoldProgress(ButtonGroup* group, Button* buttons, uint16_t numButtons, uint8_t step)
+{
+	// Same candidates as a hold, but the event has its own trigger so it can't overwrite a press
+	for(int i=0; i<numButtons; i++)
+	{
+		if((buttons[i].lastState == Pressed || buttons[i].lastState == DoublePressed) && buttons[i].timerTriggered)
+		{
+			buttons[i].holdProgress = step;
+			if(group != NULL)
+			{
+				buttons_TakeEvent(group, &buttons[i], HoldProgress);
+				buttons_Dispatch(group, &buttons[i], HoldProgress);
+			}
+			else
+			{
+				buttons[i].holdProgressTrigger = TRUE;
+			}
+		}
+	}
+}
+
+uint8_t buttons_HoldTimerAvailable(ButtonGroup* group, uint16_t holdTime)
+{
+	// The virtual hold timer only needs to know the hold time
+	if(group != NULL)
+	{
+		return holdTime != 0;
+	}
+	return timerConfigured;
+}
+
+void buttons_StartHoldTimer(ButtonGroup* group, uint32_t tickTime, uint16_t holdTime)
+{
+	if(group != NULL)
+	{
+		// As with the hardware timer, a running timer is not restarted by further presses
+		if(!group->holdRunning)
+		{
+			group->holdRunning = TRUE;
+			group->holdStart = tickTime;
+			group->holdDuration = holdTime;
+			group->holdStep = 0;
+		}
+		return;
+	}
+#if FRAMEWORK_STM32CUBE
+	// The period is set per start so the first button's profile decides the hold time.
+	// Writing the auto-reload register directly avoids re-initialising the timer
+	if(!(holdTim->Instance->CR1 & TIM_CR1_CEN))
+	{
+		__HAL_TIM_SET_AUTORELOAD(holdTim, holdTime*10 / BUTTON_HOLD_STEPS);
+#if BUTTON_HOLD_PROGRESS_STEPS > 1
+		holdStep = 0;
+#endif
+	}
+	HAL_TIM_Base_Start_IT(holdTim);
+#elif FRAMEWORK_ARDUINO
+	if(timerStartCallback != NULL)
+		timerStartCallback();
+#endif
+}
+
+void buttons_StopHoldTimer(ButtonGroup* group)
+{
+	if(group != NULL)
+	{
+		group->holdRunning = FALSE;
+		return;
+	}
+	if(!timerConfigured)
+	{
+		return;
+	}
+#if BUTTON_HOLD_PROGRESS_STEPS > 1
+	holdStep = 0;
+#endif
+#if FRAMEWORK_STM32CUBE
+	HAL_TIM_Base_Stop_IT(holdTim);
+	buttons_ResetTimerCounter();
+#elif FRAMEWORK_ARDUINO
+	if(timerStopCallback != NULL)
+		timerStopCallback();
+#endif
+}
 
-//-------------- PRIVATE FUNCTIONS --------------//
 uint8_t buttons_GetPinState(Button* button)
 {
 #if MCU_CORE_RP2040
 	return gpio_get(button->pin);
 #elif MCU_CORE_STM32
 	return HAL_GPIO_ReadPin(button->port, button->pin); 
+#elif FRAMEWORK_ARDUINO
+	return digitalRead(button->pin);
 #endif
 }
 
+void buttons_ConfigureGpio(const ButtonDesc* table, uint16_t numButtons, uint8_t interrupts)
+{
+#if FRAMEWORK_STM32CUBE
+	// Gather the pins of each port so every port takes one init call per pull direction
+	GPIO_TypeDef* ports[BUTTONS_MAX_PORTS];
+	uint16_t pullUpPins[BUTTONS_MAX_PORTS] = {0};
+	uint16_t pullDownPins[BUTTONS_MAX_PORTS] = {0};
+	uint8_t numPorts = 0;
+
+	for(int i=0; i<numButtons; i++)
+	{
+		if(table[i].source != ButtonPhysical || table[i].port == NULL)
+		{
+			continue;
+		}
+		uint8_t port = 0;
+		while(port < numPorts && ports[port] != table[i].port)
+		{
+			port++;
+		}
+		if(port == numPorts)
+		{
+			if(numPorts == BUTTONS_MAX_PORTS)
+			{
+				continue;
+			}
+			ports[numPorts++] = table[i].port;
+		}
+		if(table[i].logicMode == ActiveLow)
+			pullUpPins[port] |= table[i].pin;
+		else
+			pullDownPins[port] |= table[i].pin;
+	}
+
+	GPIO_InitTypeDef gpioInit = {0};
+	gpioInit.Mode = interrupts ? GPIO_MODE_IT_RISING_FALLING : GPIO_MODE_INPUT;
+	gpioInit.Speed = GPIO_SPEED_FREQ_LOW;
+	for(int port=0; port<numPorts; port++)
+	{
+		if(pullUpPins[port])
+		{
+			gpioInit.Pin = pullUpPins[port];
+			gpioInit.Pull = GPIO_PULLUP;
+			HAL_GPIO_Init(ports[port], &gpioInit);
+		}
+		if(pullDownPins[port])
+		{
+			gpioInit.Pin = pullDownPins[port];
+			gpioInit.Pull = GPIO_PULLDOWN;
+			HAL_GPIO_Init(ports[port], &gpioInit);
+		}
+	}
+#elif FRAMEWORK_ARDUINO
+	// Interrupts are attached by the application, so there is nothing to arm
+	for(int i=0; i<numButtons && !interrupts; i++)
+	{
+		if(table[i].source == ButtonPhysical)
+		{
+			pinMode(table[i].pin, table[i].logicMode == ActiveLow ? INPUT_PULLUP : INPUT);
+		}
+	}
+#endif
+}
+
+#if BUTTONS_VELOCITY
+uint32_t buttons_GetMicroseconds(void)
+{
+	if(microsecondCallback != NULL)
+	{
+		return microsecondCallback();
+	}
+#if FRAMEWORK_ARDUINO
+	return micros();
+#else
+	return 0;
+#endif
+}
+#endif
+
+#if BUTTONS_AUDIO_CLOCK
+uint32_t buttons_AudioEdgeFrame(ButtonAudioClock* clock, uint32_t tickTime)
+{
+	// Virtual edges may carry an earlier timestamp than now, move back by the elapsed frames
+	uint32_t frame = buttons_AudioFrameNow(clock);
+	uint32_t now;
+#if FRAMEWORK_STM32CUBE
+	now = HAL_GetTick();
+#elif FRAMEWORK_ARDUINO
+	now = millis();
+#endif
+	if(clock->sampleRate != 0 && (int32_t)(now - tickTime) > 0)
+	{
+		frame -= (uint32_t)(((uint64_t)(now - tickTime) * clock->sampleRate) / 1000);
+	}
+	return frame;
+}
+#endif
+
+#if BUTTONS_TELEMETRY
+void buttons_TelemetryEvent(Button* button, ButtonState state)
+{
+	// Kept out of the edge interrupt, which only counts presses and notes rejected edges
+	if(state == Pressed || state == DoublePressed)
+	{
+		// One sample per window per press cycle, by now the last release has stopped bouncing
+		button->bounceTrendLowToHigh = buttons_TelemetryFold(button->bounceTrendLowToHigh, button->bounceLowToHigh);
+		button->bounceTrendHighToLow = buttons_TelemetryFold(button->bounceTrendHighToLow, button->bounceHighToLow);
+		button->bounceLowToHigh = 0;
+		button->bounceHighToLow = 0;
+	}
+	else if(state == Released || state == DoublePressReleased || state == HeldReleased)
+	{
+		button->heldTime += button->pressDuration;
+	}
+}
+
+uint16_t buttons_TelemetryFold(uint16_t trend, uint16_t bounce)
+{
+	// Exponential average over about 8 press cycles, in 1/16 ms so short bounces still register
+	int32_t error = ((int32_t)bounce << 4) - trend;
+	return (uint16_t)(trend + error / 8);
+}
+
+uint8_t buttons_TelemetryOverWindow(uint16_t trend, uint16_t window)
+{
+	if(window == 0)
+	{
+		return FALSE;
+	}
+	return (uint32_t)trend * 100 >= ((uint32_t)window << 4) * BUTTONS_TELEMETRY_WEAR_PERCENT;
+}
+#endif
+
+#if BUTTONS_TRACE
+uint32_t buttons_TraceTime(ButtonGroup* group)
+{
+	// Injected events happen on the group's virtual clock
+	if(group != NULL && group->injecting)
+	{
+		return group->virtualTime;
+	}
+#if FRAMEWORK_STM32CUBE
+	return HAL_GetTick();
+#elif FRAMEWORK_ARDUINO
+	return millis();
+#endif
+}
+#endif
+
+#if BUTTONS_PROFILE
+uint32_t buttons_GetCycles(void)
+{
+	if(cycleCounterCallback != NULL)
+	{
+		return cycleCounterCallback();
+	}
+#if BUTTONS_DWT_CYCLES
+	return DWT->CYCCNT;
+#else
+	return 0;
+#endif
+}
+
+void buttons_ProfileRecord(ButtonProfilePoint point, uint32_t start, const ButtonProfileInput* input)
+{
+	uint32_t cycles = buttons_GetCycles() - start;
+	ButtonProfileStats* stats = &profileStats[point];
+	stats->calls++;
+	stats->lastCycles = cycles;
+	stats->totalCycles += cycles;
+	if(cycles > stats->maxCycles)
+	{
+		stats->maxCycles = cycles;
+		if(input != NULL)
+		{
+			stats->worstInput = *input;
+		}
+	}
+}
+#endif
+
 void buttons_ResetTimerCounter()
 {
 #if FRAMEWORK_STM32CUBE
@@ -0,0 +1,75 @@
+/*
+ * buttons_fsr.c
+ *
+ * Force sensitive resistor (FSR) pads. See buttons_fsr.h.
+ */
+
+#include "buttons_fsr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Helper Macros */
+#define TRUE	1
+#define FALSE	0
+
+
+//-------------- PUBLIC FUNCTIONS --------------//
+void buttons_FsrInit(ButtonFsr* pad)
+{
+	// The thresholds already reject noise, so the button needs no debounce timing
+	pad->button->source = ButtonVirtual;
+	pad->button->debounceBypass = TRUE;
+	pad->pressure = 0;
+	pad->lastReported = 0;
+	pad->lastReportTime = 0;
+	pad->pressed = FALSE;
+}
+
+void buttons_FsrProcessAdc(ButtonFsr* pads, uint16_t numPads, const uint16_t* samples, uint32_t timestamp)
+{
+	for(uint16_t i=0; i<numPads; i++)
+	{
+		ButtonFsr* pad = &pads[i];
+		uint16_t sample = samples[i];
+		pad->pressure = sample;
+
+		if(!pad->pressed)
+		{
+			if(sample >= pad->pressThreshold)
+			{
+				pad->pressed = TRUE;
+				pad->lastReported = sample;
+				pad->lastReportTime = timestamp;
+				buttons_VirtualEdge(pad->button, ButtonEmulatePress, timestamp);
+			}
+			continue;
+		}
+
+		if(sample < pad->releaseThreshold)
+		{
+			pad->pressed = FALSE;
+			buttons_VirtualEdge(pad->button, ButtonEmulateRelease, timestamp);
+			continue;
+		}
+
+		// Aftertouch, rate limited in both time and size of change
+		uint16_t change = sample > pad->lastReported ? sample - pad->lastReported : pad->lastReported - sample;
+		if(change >= pad->minDelta && (timestamp - pad->lastReportTime) >= pad->minInterval)
+		{
+			pad->lastReported = sample;
+			pad->lastReportTime = timestamp;
+			pad->button->pressureTrigger = TRUE;
+		}
+	}
+}
+
+uint16_t buttons_FsrGetPressure(ButtonFsr* pad)
+{
+	return pad->pressure;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,117 @@
+/*
+ * buttons_hid.c
+ *
+ * USB HID report generation from button states. See buttons_hid.h.
+ */
+
+#include "buttons_hid.h"
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Helper Macros */
+#define TRUE	1
+#define FALSE	0
+
+
+//-------------- PRIVATE FUNCTION PROTOTYPES --------------//
+uint8_t buttons_HidMappingValid(ButtonHid* hid, const ButtonHidMapping* mapping);
+
+
+//-------------- PUBLIC FUNCTIONS --------------//
+uint8_t buttons_HidInit(ButtonHid* hid)
+{
+	hid->lastEpoch = 0;
+	hid->lastGroupEpoch = 0;
+	hid->valid = FALSE;
+
+	// Keep the key array inside the report
+	uint8_t ok = TRUE;
+	hid->keySlots = hid->keyArrayLength;
+	if(hid->keyArrayStart >= hid->reportLength)
+	{
+		hid->keySlots = 0;
+	}
+	else if(hid->keyArrayLength > hid->reportLength - hid->keyArrayStart)
+	{
+		hid->keySlots = hid->reportLength - hid->keyArrayStart;
+	}
+	if(hid->keySlots != hid->keyArrayLength)
+	{
+		ok = FALSE;
+	}
+
+	for(uint16_t i=0; i<hid->numMappings; i++)
+	{
+		if(!buttons_HidMappingValid(hid, &hid->mappings[i]))
+		{
+			ok = FALSE;
+		}
+	}
+	return ok;
+}
+
+uint8_t buttons_HidBuildReport(ButtonHid* hid, uint8_t* report)
+{
+	// Take the epoch before reading any state, so a change during the build
+	// still causes a rebuild on the next poll
+	uint32_t epoch = buttons_GetStateEpoch();
+	uint32_t groupEpoch = hid->group != NULL ? buttons_GetGroupStateEpoch(hid->group) : 0;
+	if(hid->valid && epoch == hid->lastEpoch && groupEpoch == hid->lastGroupEpoch)
+	{
+		return FALSE;
+	}
+	hid->lastEpoch = epoch;
+	hid->lastGroupEpoch = groupEpoch;
+	hid->valid = TRUE;
+
+	memset(report, 0, hid->reportLength);
+	uint8_t keyCount = 0;
+	for(uint16_t i=0; i<hid->numMappings; i++)
+	{
+		const ButtonHidMapping* mapping = &hid->mappings[i];
+		if(!buttons_HidMappingValid(hid, mapping) ||
+			!buttons_IsPressed(&hid->group->buttons[mapping->button]))
+		{
+			continue;
+		}
+		if(mapping->type == ButtonHidBit)
+		{
+			report[mapping->reportByte] |= 1 << mapping->value;
+		}
+		else
+		{
+			if(keyCount < hid->keySlots)
+				report[hid->keyArrayStart + keyCount] = mapping->value;
+			keyCount++;
+		}
+	}
+
+	// Too many keys for the array
+	if(keyCount > hid->keySlots)
+	{
+		memset(&report[hid->keyArrayStart], BUTTONS_HID_ERROR_ROLLOVER, hid->keySlots);
+	}
+	return TRUE;
+}
+
+
+//-------------- PRIVATE FUNCTIONS --------------//
+uint8_t buttons_HidMappingValid(ButtonHid* hid, const ButtonHidMapping* mapping)
+{
+	if(mapping->button >= hid->group->numButtons)
+	{
+		return FALSE;
+	}
+	if(mapping->type == ButtonHidBit)
+	{
+		return mapping->reportByte < hid->reportLength && mapping->value < 8;
+	}
+	return mapping->type == ButtonHidKey;
+}
+
+#ifdef __cplusplus
+}
+#endif
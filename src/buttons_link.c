@@ -0,0 +1,378 @@
+/*
+ * buttons_link.c
+ *
+ * Inter-MCU button event link. See buttons_link.h for the frame format and usage.
+ */
+
+#include "buttons_link.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Helper Macros */
+#define TRUE	1
+#define FALSE	0
+
+// Bytes before the event payload (sync, seq, count)
+#define LINK_HEADER_SIZE 3
+
+//-------------- PRIVATE FUNCTION PROTOTYPES --------------//
+uint16_t buttons_LinkCrc(const uint8_t* data, uint16_t length);
+uint8_t buttons_LinkQueueFull(ButtonLink* link);
+void buttons_LinkCheckFrame(ButtonLink* link);
+void buttons_LinkResync(ButtonLink* link);
+void buttons_LinkDeliver(ButtonLink* link, const uint8_t* frame);
+uint8_t buttons_LinkApply(ButtonLink* link, const ButtonLinkEvent* event);
+
+
+//-------------- PUBLIC FUNCTIONS --------------//
+void buttons_LinkInit(ButtonLink* link, ButtonGroup* group)
+{
+	link->group = group;
+	link->txHead = 0;
+	link->txTail = 0;
+	link->txSeq = 0;
+	link->txBusy = FALSE;
+	link->rxIndex = 0;
+	link->rxSeq = 0;
+	link->rxSynced = FALSE;
+	link->rxHead = 0;
+	link->rxTail = 0;
+#if FRAMEWORK_STM32CUBE
+	link->rxParsed = 0;
+#endif
+	link->txDropped = 0;
+	link->rxDropped = 0;
+	link->rxLost = 0;
+	link->rxCrcErrors = 0;
+}
+
+uint8_t buttons_LinkQueueEvent(ButtonLink* link, uint16_t button, ButtonState state)
+{
+	// Single producer, single consumer ring. Only the head is written here
+	if(buttons_LinkQueueFull(link) || button > 0xFF)
+	{
+		link->txDropped++;
+		return FALSE;
+	}
+	link->txQueue[link->txHead].button = (uint8_t)button;
+	link->txQueue[link->txHead].state = (uint8_t)state;
+	link->txHead = (link->txHead + 1) % BUTTONS_LINK_QUEUE_SIZE;
+	return TRUE;
+}
+
+void buttons_LinkPoll(ButtonLink* link, ButtonGroup* group)
+{
+	// Forward pending events instead of calling handlers.
+	// If the queue is full the event stays pending and is retried on the next poll
+	for(int i=0; i<group->numButtons; i++)
+	{
+		Button* button = &group->buttons[i];
+		if(button->state != Cleared)
+		{
+			if(buttons_LinkQueueFull(link))
+			{
+				return;
+			}
+			ButtonState state = button->state;
+			buttons_LinkQueueEvent(link, i, state);
+			buttons_TakeEvent(group, button, state);
+		}
+		if(button->accelerationTrigger)
+		{
+			if(buttons_LinkQueueFull(link))
+			{
+				return;
+			}
+			buttons_LinkQueueEvent(link, i, HeldRepeat);
+			buttons_TakeEvent(group, button, HeldRepeat);
+		}
+		if(button->holdProgressTrigger)
+		{
+			if(buttons_LinkQueueFull(link))
+			{
+				return;
+			}
+			buttons_LinkQueueEvent(link, i, HoldProgress);
+			buttons_TakeEvent(group, button, HoldProgress);
+		}
+		if(button->pressureTrigger)
+		{
+			if(buttons_LinkQueueFull(link))
+			{
+				return;
+			}
+			buttons_LinkQueueEvent(link, i, PressureChanged);
+			buttons_TakeEvent(group, button, PressureChanged);
+		}
+	}
+}
+
+uint16_t buttons_LinkBuildFrame(ButtonLink* link, uint8_t* frame)
+{
+	uint8_t count = 0;
+	uint8_t* payload = &frame[LINK_HEADER_SIZE];
+
+	// Batch as many queued events as fit in one frame. Only the tail is written here
+	while(link->txTail != link->txHead && count < BUTTONS_LINK_MAX_EVENTS)
+	{
+		payload[2*count] = link->txQueue[link->txTail].button;
+		payload[2*count + 1] = link->txQueue[link->txTail].state;
+		link->txTail = (link->txTail + 1) % BUTTONS_LINK_QUEUE_SIZE;
+		count++;
+	}
+	if(count == 0)
+	{
+		return 0;
+	}
+	frame[0] = BUTTONS_LINK_SYNC;
+	frame[1] = link->txSeq++;
+	frame[2] = count;
+
+	uint16_t length = LINK_HEADER_SIZE + 2*count;
+	uint16_t crc = buttons_LinkCrc(&frame[1], length - 1);
+	frame[length] = crc & 0xFF;
+	frame[length + 1] = crc >> 8;
+	return length + 2;
+}
+
+void buttons_LinkParse(ButtonLink* link, const uint8_t* data, uint16_t length)
+{
+	for(uint16_t i=0; i<length; i++)
+	{
+		uint8_t byte = data[i];
+
+		// Hunt for the start of a frame
+		if(link->rxIndex == 0 && byte != BUTTONS_LINK_SYNC)
+		{
+			continue;
+		}
+		link->rxFrame[link->rxIndex++] = byte;
+		buttons_LinkCheckFrame(link);
+	}
+}
+
+void buttons_LinkDispatch(ButtonLink* link)
+{
+	if(link->group == NULL)
+	{
+		return;
+	}
+	// Apply received events in order. An event for a button that still has one pending
+	// waits until a poll has dispatched that one, so no event overwrites another
+	while(link->rxTail != link->rxHead)
+	{
+		if(!buttons_LinkApply(link, &link->rxQueue[link->rxTail]))
+		{
+			buttons_GroupTriggerPoll(link->group);
+			continue;
+		}
+		link->rxTail = (link->rxTail + 1) % BUTTONS_LINK_QUEUE_SIZE;
+	}
+	buttons_GroupTriggerPoll(link->group);
+}
+
+#if FRAMEWORK_STM32CUBE
+void buttons_LinkService(ButtonLink* link)
+{
+	if(link->txBusy)
+	{
+		return;
+	}
+	uint16_t length = buttons_LinkBuildFrame(link, link->txFrame);
+	if(length == 0)
+	{
+		return;
+	}
+	link->txBusy = TRUE;
+	if(HAL_UART_Transmit_DMA(link->uart, link->txFrame, length) != HAL_OK)
+	{
+		link->txBusy = FALSE;
+	}
+}
+
+void buttons_LinkTxComplete(ButtonLink* link)
+{
+	// Chain the next frame straight away if more events were queued during the transfer
+	link->txBusy = FALSE;
+	buttons_LinkService(link);
+}
+
+void buttons_LinkStartReceive(ButtonLink* link)
+{
+	link->rxParsed = 0;
+	HAL_UARTEx_ReceiveToIdle_DMA(link->uart, link->rxBuffer, BUTTONS_LINK_RX_SIZE);
+}
+
+void buttons_LinkRxEvent(ButtonLink* link, uint16_t size)
+{
+	// Called on half transfer, idle line or a full buffer with the number of bytes received so far
+	// in this receive. Only parse what is new, as a half transfer is followed by the cumulative size
+	if(size > link->rxParsed)
+	{
+		buttons_LinkParse(link, &link->rxBuffer[link->rxParsed], size - link->rxParsed);
+	}
+	link->rxParsed = size;
+
+	// On half transfer the receive is still running and this is refused
+	if(HAL_UARTEx_ReceiveToIdle_DMA(link->uart, link->rxBuffer, BUTTONS_LINK_RX_SIZE) == HAL_OK)
+	{
+		link->rxParsed = 0;
+	}
+}
+#endif
+
+
+//-------------- PRIVATE FUNCTIONS --------------//
+uint16_t buttons_LinkCrc(const uint8_t* data, uint16_t length)
+{
+	// CRC-16/CCITT-FALSE
+	uint16_t crc = 0xFFFF;
+	for(uint16_t i=0; i<length; i++)
+	{
+		crc ^= (uint16_t)data[i] << 8;
+		for(int bit=0; bit<8; bit++)
+		{
+			if(crc & 0x8000)
+				crc = (crc << 1) ^ 0x1021;
+			else
+				crc <<= 1;
+		}
+	}
+	return crc;
+}
+
+uint8_t buttons_LinkQueueFull(ButtonLink* link)
+{
+	return ((link->txHead + 1) % BUTTONS_LINK_QUEUE_SIZE) == link->txTail;
+}
+
+void buttons_LinkCheckFrame(ButtonLink* link)
+{
+	// Evaluate the buffered bytes, which after a resync may already hold a whole frame
+	while(link->rxIndex >= LINK_HEADER_SIZE)
+	{
+		// Reject impossible event counts straight away so resynchronisation is quick
+		if(link->rxFrame[2] == 0 || link->rxFrame[2] > BUTTONS_LINK_MAX_EVENTS)
+		{
+			buttons_LinkResync(link);
+			continue;
+		}
+
+		uint16_t payloadEnd = LINK_HEADER_SIZE + 2*link->rxFrame[2];
+		if(link->rxIndex < payloadEnd + 2)
+		{
+			return;
+		}
+
+		// Complete frame
+		uint16_t crc = link->rxFrame[payloadEnd] | (link->rxFrame[payloadEnd + 1] << 8);
+		if(crc != buttons_LinkCrc(&link->rxFrame[1], payloadEnd - 1))
+		{
+			link->rxCrcErrors++;
+			buttons_LinkResync(link);
+			continue;
+		}
+		link->rxIndex = 0;
+		if(link->rxSynced)
+		{
+			link->rxLost += (uint8_t)(link->rxFrame[1] - link->rxSeq);
+		}
+		link->rxSeq = link->rxFrame[1] + 1;
+		link->rxSynced = TRUE;
+		buttons_LinkDeliver(link, link->rxFrame);
+	}
+}
+
+void buttons_LinkResync(ButtonLink* link)
+{
+	// The sync byte was noise, a real frame may start anywhere in the bytes buffered after it
+	uint16_t start = 1;
+	while(start < link->rxIndex && link->rxFrame[start] != BUTTONS_LINK_SYNC)
+	{
+		start++;
+	}
+	for(uint16_t i=start; i<link->rxIndex; i++)
+	{
+		link->rxFrame[i - start] = link->rxFrame[i];
+	}
+	link->rxIndex -= start;
+}
+
+void buttons_LinkDeliver(ButtonLink* link, const uint8_t* frame)
+{
+	// Queue remote events for buttons_LinkDispatch(), this may run in the UART interrupt
+	const uint8_t* payload = &frame[LINK_HEADER_SIZE];
+	for(int i=0; i<frame[2]; i++)
+	{
+		uint8_t index = payload[2*i];
+		uint8_t state = payload[2*i + 1];
+		if(link->group == NULL || index >= link->group->numButtons || state == Cleared || state > PressureChanged)
+		{
+			continue;
+		}
+		uint16_t next = (link->rxHead + 1) % BUTTONS_LINK_QUEUE_SIZE;
+		if(next == link->rxTail)
+		{
+			link->rxDropped++;
+			continue;
+		}
+		link->rxQueue[link->rxHead].button = index;
+		link->rxQueue[link->rxHead].state = state;
+		link->rxHead = next;
+	}
+}
+
+uint8_t buttons_LinkApply(ButtonLink* link, const ButtonLinkEvent* event)
+{
+	Button* button = &link->group->buttons[event->button];
+	ButtonState state = (ButtonState)event->state;
+
+	// Events without a state of their own only raise their trigger
+	volatile uint8_t* trigger = NULL;
+	if(state == HeldRepeat)
+	{
+		trigger = &button->accelerationTrigger;
+	}
+	else if(state == HoldProgress)
+	{
+		trigger = &button->holdProgressTrigger;
+	}
+	else if(state == PressureChanged)
+	{
+		trigger = &button->pressureTrigger;
+	}
+	if(trigger != NULL)
+	{
+		if(*trigger)
+		{
+			return FALSE;
+		}
+#if BUTTON_HOLD_PROGRESS_STEPS > 1
+		if(state == HoldProgress && button->holdProgress < BUTTON_HOLD_PROGRESS_STEPS)
+		{
+			button->holdProgress++;
+		}
+#endif
+		*trigger = TRUE;
+		return TRUE;
+	}
+
+	if(button->state != Cleared)
+	{
+		return FALSE;
+	}
+	if(state == Pressed || state == DoublePressed)
+	{
+		button->holdProgress = 0;
+	}
+	button->state = state;
+	button->lastState = state;
+	buttons_BumpStateEpoch();
+	return TRUE;
+}
+
+#ifdef __cplusplus
+}
+#endif
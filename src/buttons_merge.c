@@ -0,0 +1,203 @@
+/*
+ * buttons_merge.c
+ *
+ * Timestamp ordered merging of events from several sources. See buttons_merge.h.
+ */
+
+#include "buttons_merge.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Helper Macros */
+#define TRUE	1
+#define FALSE	0
+
+// Wraparound safe "a is earlier than b"
+#define TIME_BEFORE(a, b) ((int32_t)((a) - (b)) < 0)
+
+// Kinds of pending event a button can hold at once
+typedef enum
+{
+	PendingState,
+	PendingRepeat,
+	PendingProgress,
+	PendingPressure,
+	PendingCount
+} PendingKind;
+
+//-------------- PRIVATE FUNCTION PROTOTYPES --------------//
+uint8_t buttons_QueuePending(ButtonGroup* group, Button* button, PendingKind kind, ButtonState* state, uint32_t* timestamp);
+uint8_t buttons_QueueFull(ButtonEventQueue* queue);
+
+
+//-------------- PUBLIC FUNCTIONS --------------//
+void buttons_QueueInit(ButtonEventQueue* queue)
+{
+	queue->head = 0;
+	queue->tail = 0;
+	queue->dropped = 0;
+}
+
+uint8_t buttons_QueuePush(ButtonEventQueue* queue, uint16_t button, ButtonState state, uint32_t timestamp)
+{
+	uint16_t next = (queue->head + 1) % BUTTONS_EVENT_QUEUE_SIZE;
+	if(next == queue->tail)
+	{
+		queue->dropped++;
+		return FALSE;
+	}
+	ButtonEvent* event = &queue->events[queue->head];
+	event->button = button;
+	event->source = 0;
+	event->state = state;
+	event->timestamp = timestamp;
+	queue->head = next;
+	return TRUE;
+}
+
+uint8_t buttons_QueuePop(ButtonEventQueue* queue, ButtonEvent* event)
+{
+	if(queue->tail == queue->head)
+	{
+		return FALSE;
+	}
+	*event = queue->events[queue->tail];
+	queue->tail = (queue->tail + 1) % BUTTONS_EVENT_QUEUE_SIZE;
+	return TRUE;
+}
+
+void buttons_QueuePoll(ButtonGroup* group, ButtonEventQueue* queue)
+{
+	// The merger relies on each queue being in time order, so pending events are queued
+	// earliest first rather than in button order. A repeated scan for the earliest is cheap
+	// for the few events a poll finds, and needs no buffer. Events that don't fit stay
+	// pending for the next poll
+	while(!buttons_QueueFull(queue))
+	{
+		int earliest = -1;
+		ButtonState earliestState = Cleared;
+		uint32_t earliestTime = 0;
+		for(int i=0; i<group->numButtons; i++)
+		{
+			for(int kind=0; kind<PendingCount; kind++)
+			{
+				ButtonState state;
+				uint32_t timestamp;
+				if(buttons_QueuePending(group, &group->buttons[i], (PendingKind)kind, &state, &timestamp) &&
+					(earliest < 0 || TIME_BEFORE(timestamp, earliestTime)))
+				{
+					earliest = i;
+					earliestState = state;
+					earliestTime = timestamp;
+				}
+			}
+		}
+		if(earliest < 0)
+		{
+			return;
+		}
+		buttons_TakeEvent(group, &group->buttons[earliest], earliestState);
+		buttons_QueuePush(queue, earliest, earliestState, earliestTime);
+	}
+}
+
+void buttons_MergerInit(ButtonMerger* merger, ButtonEventQueue** sources, uint8_t numSources, uint32_t window)
+{
+	merger->sources = sources;
+	merger->numSources = numSources;
+	merger->window = window;
+}
+
+uint8_t buttons_MergerPop(ButtonMerger* merger, uint32_t now, ButtonEvent* event)
+{
+	// k-way merge: each queue is already in time order, so the earliest event overall
+	// is the earliest of the queue heads. A linear scan is cheapest for the handful
+	// of sources an embedded system has
+	int earliest = -1;
+	uint32_t earliestTime = 0;
+	for(int i=0; i<merger->numSources; i++)
+	{
+		ButtonEventQueue* queue = merger->sources[i];
+		if(queue->tail == queue->head)
+		{
+			continue;
+		}
+		uint32_t timestamp = queue->events[queue->tail].timestamp;
+		if(earliest < 0 || TIME_BEFORE(timestamp, earliestTime))
+		{
+			earliest = i;
+			earliestTime = timestamp;
+		}
+	}
+
+	// Hold the event back until no source could still deliver something earlier
+	if(earliest < 0 || TIME_BEFORE(now - merger->window, earliestTime))
+	{
+		return FALSE;
+	}
+	buttons_QueuePop(merger->sources[earliest], event);
+	event->source = earliest;
+	return TRUE;
+}
+
+
+//-------------- PRIVATE FUNCTIONS --------------//
+uint8_t buttons_QueuePending(ButtonGroup* group, Button* button, PendingKind kind, ButtonState* state, uint32_t* timestamp)
+{
+	// Events are stamped with the time of the edge that caused them. Holds and hold progress
+	// happen a (part of the) hold time after the press edge. Repeats and pressure changes have
+	// no edge, so they take the group's virtual time for injected groups, or the current time
+	uint32_t now = group->virtualTime;
+	if(!group->virtualClock)
+	{
+#if FRAMEWORK_STM32CUBE
+		now = HAL_GetTick();
+#elif FRAMEWORK_ARDUINO
+		now = millis();
+#endif
+	}
+	switch(kind)
+	{
+	case PendingState:
+		if(button->state == Cleared)
+		{
+			return FALSE;
+		}
+		*state = button->state;
+		*timestamp = button->lastTime;
+		if(*state == Held)
+		{
+			*timestamp += buttons_GetHoldTime(button);
+		}
+		return TRUE;
+	case PendingRepeat:
+		*state = HeldRepeat;
+		*timestamp = now;
+		return button->accelerationTrigger;
+	case PendingProgress:
+#if BUTTON_HOLD_PROGRESS_STEPS > 1
+		*state = HoldProgress;
+		*timestamp = button->lastTime + (uint32_t)buttons_GetHoldTime(button) * button->holdProgress / BUTTON_HOLD_PROGRESS_STEPS;
+		return button->holdProgressTrigger;
+#else
+		return FALSE;
+#endif
+	case PendingPressure:
+		*state = PressureChanged;
+		*timestamp = now;
+		return button->pressureTrigger;
+	default:
+		return FALSE;
+	}
+}
+
+uint8_t buttons_QueueFull(ButtonEventQueue* queue)
+{
+	return ((queue->head + 1) % BUTTONS_EVENT_QUEUE_SIZE) == queue->tail;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,187 @@
+/*
+ * buttons_midi.c
+ *
+ * MIDI output driven by button events. See buttons_midi.h.
+ */
+
+#include "buttons_midi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Helper Macros */
+#define TRUE	1
+#define FALSE	0
+
+//-------------- PRIVATE FUNCTION PROTOTYPES --------------//
+uint8_t buttons_MidiMessageLength(uint8_t status);
+uint16_t buttons_MidiRingCount(ButtonMidi* midi);
+
+
+//-------------- PUBLIC FUNCTIONS --------------//
+void buttons_MidiInit(ButtonMidi* midi)
+{
+	midi->head = 0;
+	midi->tail = 0;
+	midi->inFlight = 0;
+	midi->txBusy = FALSE;
+	midi->runningStatus = 0;
+	midi->dropped = 0;
+	midi->bindingSet = NULL;
+}
+
+const ButtonMidiBindingSet* buttons_MidiPublishBindings(ButtonMidi* midi, const ButtonMidiBindingSet* bindingSet)
+{
+	const ButtonMidiBindingSet* previous = midi->bindingSet;
+	__sync_synchronize();
+	midi->bindingSet = bindingSet;
+	return previous;
+}
+
+uint16_t buttons_MidiEvent(ButtonMidi* midi, uint16_t button, ButtonState state)
+{
+	// Format every binding for this event, returns the number of messages queued
+	uint16_t queued = 0;
+	const ButtonMidiBindingSet* bindingSet = midi->bindingSet;
+	if(bindingSet == NULL)
+	{
+		return 0;
+	}
+	for(uint16_t i=0; i<bindingSet->numBindings; i++)
+	{
+		const ButtonMidiBinding* binding = &bindingSet->bindings[i];
+		if(binding->button == button && binding->state == state)
+		{
+			queued += buttons_MidiSend(midi, binding->status, binding->data1, binding->data2);
+		}
+	}
+	return queued;
+}
+
+uint8_t buttons_MidiSend(ButtonMidi* midi, uint8_t status, uint8_t data1, uint8_t data2)
+{
+	uint8_t length = buttons_MidiMessageLength(status);
+	if(length == 0)
+	{
+		return FALSE;
+	}
+	uint8_t bytes[3] = {status, (uint8_t)(data1 & 0x7F), (uint8_t)(data2 & 0x7F)};
+	uint8_t start = 0;
+	if(!midi->usb && midi->useRunningStatus && status == midi->runningStatus)
+	{
+		start = 1;
+	}
+
+	// Only whole messages are queued, otherwise the receiver would lose sync
+	if(BUTTONS_MIDI_RING_SIZE - 1 - buttons_MidiRingCount(midi) < length - start)
+	{
+		midi->dropped++;
+		return FALSE;
+	}
+	uint16_t head = midi->head;
+	for(uint8_t i=start; i<length; i++)
+	{
+		midi->ring[head] = bytes[i];
+		head = (head + 1) % BUTTONS_MIDI_RING_SIZE;
+	}
+	midi->head = head;
+	if(!midi->usb)
+	{
+		midi->runningStatus = status;
+	}
+	return TRUE;
+}
+
+void buttons_MidiDrain(ButtonMidi* midi)
+{
+	if(midi->txBusy || midi->transmit == NULL)
+	{
+		return;
+	}
+	uint16_t head = midi->head;
+	uint16_t tail = midi->tail;
+	if(head == tail)
+	{
+		return;
+	}
+	// Send everything up to the head, or up to the end of the ring if it wraps
+	uint16_t length = head > tail ? head - tail : BUTTONS_MIDI_RING_SIZE - tail;
+	midi->inFlight = length;
+	midi->txBusy = TRUE;
+	if(!midi->transmit(&midi->ring[tail], length))
+	{
+		midi->inFlight = 0;
+		midi->txBusy = FALSE;
+	}
+}
+
+void buttons_MidiTxComplete(ButtonMidi* midi)
+{
+	midi->tail = (midi->tail + midi->inFlight) % BUTTONS_MIDI_RING_SIZE;
+	midi->inFlight = 0;
+	midi->txBusy = FALSE;
+	buttons_MidiDrain(midi);
+}
+
+uint16_t buttons_MidiBuildUsbPackets(ButtonMidi* midi, uint8_t* packets, uint16_t maxPackets)
+{
+	// Messages are queued whole for USB, each becomes one packet with its code index number
+	uint16_t count = 0;
+	while(count < maxPackets && midi->tail != midi->head)
+	{
+		uint16_t tail = midi->tail;
+		uint8_t status = midi->ring[tail];
+		tail = (tail + 1) % BUTTONS_MIDI_RING_SIZE;
+		uint8_t length = buttons_MidiMessageLength(status);
+		if(length == 0)
+		{
+			// Not a status byte, so not queued for USB. Skip it rather than lose sync
+			midi->tail = tail;
+			continue;
+		}
+		uint8_t* packet = &packets[4*count];
+		packet[0] = (midi->cable << 4) | (status >> 4);
+		packet[1] = status;
+		packet[2] = 0;
+		packet[3] = 0;
+		for(uint8_t i=1; i<length; i++)
+		{
+			packet[1 + i] = midi->ring[tail];
+			tail = (tail + 1) % BUTTONS_MIDI_RING_SIZE;
+		}
+		midi->tail = tail;
+		count++;
+	}
+	return 4*count;
+}
+
+
+//-------------- PRIVATE FUNCTIONS --------------//
+uint8_t buttons_MidiMessageLength(uint8_t status)
+{
+	// Channel voice messages only
+	switch(status & 0xF0)
+	{
+	case 0x80:
+	case 0x90:
+	case 0xA0:
+	case 0xB0:
+	case 0xE0:
+		return 3;
+	case 0xC0:
+	case 0xD0:
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+uint16_t buttons_MidiRingCount(ButtonMidi* midi)
+{
+	return (midi->head - midi->tail + BUTTONS_MIDI_RING_SIZE) % BUTTONS_MIDI_RING_SIZE;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,78 @@
+/*
+ * buttons_scan.c
+ *
+ * Bit-parallel debounce of polled input ports. See buttons_scan.h.
+ */
+
+#include "buttons_scan.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Helper Macros */
+#define TRUE	1
+#define FALSE	0
+
+
+//-------------- PUBLIC FUNCTIONS --------------//
+void buttons_ScanInit(ButtonScanPort* port)
+{
+	// The vertical counter already debounces, so the buttons need no debounce timing
+	for(uint8_t i=0; i<BUTTONS_SCAN_LANES; i++)
+	{
+		Button* button = port->buttons[i];
+		if(button != NULL && (port->laneMask & (1UL << i)))
+		{
+			button->source = ButtonVirtual;
+			button->debounceBypass = TRUE;
+		}
+	}
+	// Counters idle at 3 and count down on every sample that differs from the debounced level
+	port->counter0 = 0xFFFFFFFFUL;
+	port->counter1 = 0xFFFFFFFFUL;
+	port->state = 0;
+}
+
+uint32_t buttons_ScanProcess(ButtonScanPort* port, uint32_t sample, uint32_t timestamp)
+{
+	uint32_t pressed = (sample ^ port->activeLowMask) & port->laneMask;
+	uint32_t changed = pressed ^ port->state;
+
+	// Lanes at their debounced level reload to 3, the others count down and wrap back to 3
+	// on the fourth differing sample, which is when they toggle
+	port->counter0 = ~(port->counter0 & changed);
+	port->counter1 = port->counter0 ^ (port->counter1 & changed);
+	changed &= port->counter0 & port->counter1;
+	port->state ^= changed;
+
+	uint32_t pending = changed;
+	while(pending != 0)
+	{
+		uint8_t lane = (uint8_t)__builtin_ctz(pending);
+		pending &= pending - 1;
+		Button* button = port->buttons[lane];
+		if(button == NULL)
+		{
+			continue;
+		}
+		if(port->state & (1UL << lane))
+		{
+			buttons_VirtualEdge(button, ButtonEmulatePress, timestamp);
+		}
+		else
+		{
+			buttons_VirtualEdge(button, ButtonEmulateRelease, timestamp);
+		}
+	}
+	return changed;
+}
+
+uint32_t buttons_ScanGetState(ButtonScanPort* port)
+{
+	return port->state;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,262 @@
+/*
+ * buttons_trace.c
+ *
+ * Non-blocking edge and event trace stream. See buttons_trace.h for the record format and usage.
+ */
+
+#include "buttons_trace.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if BUTTONS_TRACE
+
+/* Helper Macros */
+#define TRUE	1
+#define FALSE	0
+
+// Edges may be recorded from several interrupts and the main loop, so the slot is claimed
+// and written with the local core's interrupts masked. That is a handful of instructions,
+// takes no lock and never waits. Records may come from code that already masked interrupts,
+// so the previous mask is restored rather than interrupts enabled
+#if defined(BUTTONS_TRACE_LOCK)
+#define TRACE_LOCK() BUTTONS_TRACE_LOCK()
+#define TRACE_UNLOCK() BUTTONS_TRACE_UNLOCK()
+#elif FRAMEWORK_STM32CUBE
+#define TRACE_LOCK() uint32_t primask = __get_PRIMASK(); __disable_irq()
+#define TRACE_UNLOCK() __set_PRIMASK(primask)
+#elif FRAMEWORK_ARDUINO && defined(__AVR__)
+#define TRACE_LOCK() uint8_t sreg = SREG; cli()
+#define TRACE_UNLOCK() SREG = sreg
+#elif FRAMEWORK_ARDUINO && defined(__arm__)
+// Not every Arduino ARM core exposes the CMSIS intrinsics
+#define TRACE_LOCK() uint32_t primask; __asm__ volatile("mrs %0, primask\n\tcpsid i" : "=r"(primask) :: "memory")
+#define TRACE_UNLOCK() __asm__ volatile("msr primask, %0" :: "r"(primask) : "memory")
+#elif FRAMEWORK_ARDUINO && defined(ARDUINO_ARCH_ESP32)
+// Only this core is masked, the other one records into its own queue
+#define TRACE_LOCK() UBaseType_t savedMask = portSET_INTERRUPT_MASK_FROM_ISR()
+#define TRACE_UNLOCK() portCLEAR_INTERRUPT_MASK_FROM_ISR(savedMask)
+#elif FRAMEWORK_ARDUINO && defined(ARDUINO_ARCH_ESP8266)
+#define TRACE_LOCK() uint32_t savedPs = xt_rsil(15)
+#define TRACE_UNLOCK() xt_wsr_ps(savedPs)
+#else
+#error "buttons_trace.c: no interrupt mask save and restore for this core, define BUTTONS_TRACE_LOCK() and BUTTONS_TRACE_UNLOCK()"
+#endif
+
+// Queue of the calling core. With interrupts masked the caller can't move to another core
+#if BUTTONS_TRACE_CORES == 1
+#define TRACE_CORE() 0
+#elif defined(BUTTONS_TRACE_CORE)
+#define TRACE_CORE() BUTTONS_TRACE_CORE()
+#elif FRAMEWORK_ARDUINO && defined(ARDUINO_ARCH_ESP32)
+#define TRACE_CORE() xPortGetCoreID()
+#else
+#error "buttons_trace.c: define BUTTONS_TRACE_CORE() to return the index of the calling core"
+#endif
+
+// A queue may be drained from another core than the one writing it, so the record must be
+// visible before the head that publishes it, and read only after the head
+#if BUTTONS_TRACE_CORES > 1
+#define TRACE_FENCE() __sync_synchronize()
+#else
+#define TRACE_FENCE()
+#endif
+
+// Button index of buttons outside the sink's array
+#define TRACE_NO_BUTTON 0xFF
+
+ButtonTraceSink* activeSink = NULL;
+
+//-------------- PRIVATE FUNCTION PROTOTYPES --------------//
+void buttons_TraceCallback(Button* button, ButtonTraceType type, uint8_t value, uint32_t timestamp);
+void buttons_TraceSerialise(uint8_t* data, uint8_t type, uint8_t button, uint8_t value, uint32_t timestamp);
+ButtonTraceQueue* buttons_TraceOldestQueue(ButtonTraceSink* sink);
+
+
+//-------------- PUBLIC FUNCTIONS --------------//
+void buttons_TraceInit(ButtonTraceSink* sink, Button* buttons, uint16_t numButtons)
+{
+	sink->buttons = buttons;
+	sink->numButtons = numButtons;
+	for(uint8_t i=0; i<BUTTONS_TRACE_CORES; i++)
+	{
+		sink->queues[i].head = 0;
+		sink->queues[i].tail = 0;
+		sink->queues[i].dropped = 0;
+	}
+	sink->txBusy = FALSE;
+	sink->txIndex = 0;
+	sink->txLength = 0;
+	sink->reportedDropped = 0;
+	activeSink = sink;
+	buttons_AssignTraceCallback(buttons_TraceCallback);
+}
+
+void buttons_TraceRecord(ButtonTraceSink* sink, Button* button, ButtonTraceType type, uint8_t value, uint32_t timestamp)
+{
+	uint8_t index = TRACE_NO_BUTTON;
+	if(button >= sink->buttons && button < sink->buttons + sink->numButtons && (button - sink->buttons) < TRACE_NO_BUTTON)
+	{
+		index = (uint8_t)(button - sink->buttons);
+	}
+
+	TRACE_LOCK();
+	ButtonTraceQueue* queue = &sink->queues[TRACE_CORE()];
+	uint16_t next = (queue->head + 1) % BUTTONS_TRACE_QUEUE_SIZE;
+	if(next == queue->tail)
+	{
+		queue->dropped++;
+	}
+	else
+	{
+		ButtonTraceRecord* record = &queue->queue[queue->head];
+		record->type = (uint8_t)type;
+		record->button = index;
+		record->value = value;
+		record->timestamp = timestamp;
+		TRACE_FENCE();
+		queue->head = next;
+	}
+	TRACE_UNLOCK();
+}
+
+uint16_t buttons_TraceBuild(ButtonTraceSink* sink, uint8_t* buffer, uint16_t size)
+{
+	uint16_t length = 0;
+
+	// Report new drops ahead of the records that follow the gap
+	uint32_t dropped = buttons_TraceGetDropped(sink);
+	if(dropped != sink->reportedDropped && size >= BUTTONS_TRACE_RECORD_SIZE)
+	{
+		buttons_TraceSerialise(buffer, ButtonTraceDropped, TRACE_NO_BUTTON, 0, dropped);
+		sink->reportedDropped = dropped;
+		length += BUTTONS_TRACE_RECORD_SIZE;
+	}
+
+	// Only the tails are written here. The oldest record of all the queues goes first
+	ButtonTraceQueue* queue;
+	while((queue = buttons_TraceOldestQueue(sink)) != NULL && length + BUTTONS_TRACE_RECORD_SIZE <= size)
+	{
+		const ButtonTraceRecord* record = &queue->queue[queue->tail];
+		buttons_TraceSerialise(&buffer[length], record->type, record->button, record->value, record->timestamp);
+		queue->tail = (queue->tail + 1) % BUTTONS_TRACE_QUEUE_SIZE;
+		length += BUTTONS_TRACE_RECORD_SIZE;
+	}
+	return length;
+}
+
+uint32_t buttons_TraceGetDropped(ButtonTraceSink* sink)
+{
+	uint32_t dropped = 0;
+	for(uint8_t i=0; i<BUTTONS_TRACE_CORES; i++)
+	{
+		dropped += sink->queues[i].dropped;
+	}
+	return dropped;
+}
+
+#if BUTTONS_TRACE_UART
+void buttons_TraceServiceUart(ButtonTraceSink* sink)
+{
+	if(sink->txBusy)
+	{
+		return;
+	}
+	uint16_t length = buttons_TraceBuild(sink, sink->txFrame, sizeof(sink->txFrame));
+	if(length == 0)
+	{
+		return;
+	}
+	sink->txBusy = TRUE;
+	if(HAL_UART_Transmit_DMA(sink->uart, sink->txFrame, length) != HAL_OK)
+	{
+		sink->txBusy = FALSE;
+	}
+}
+
+void buttons_TraceTxComplete(ButtonTraceSink* sink)
+{
+	// Chain the next transfer straight away if more records arrived meanwhile
+	sink->txBusy = FALSE;
+	buttons_TraceServiceUart(sink);
+}
+#endif
+
+#if BUTTONS_TRACE_ITM
+void buttons_TraceServiceItm(ButtonTraceSink* sink)
+{
+	// Nothing is listening unless the debugger enabled the ITM and stimulus port 0
+	if(!(ITM->TCR & ITM_TCR_ITMENA_Msk) || !(ITM->TER & 1UL))
+	{
+		return;
+	}
+	for(;;)
+	{
+		if(sink->txIndex == sink->txLength)
+		{
+			sink->txIndex = 0;
+			sink->txLength = buttons_TraceBuild(sink, sink->txFrame, sizeof(sink->txFrame));
+			if(sink->txLength == 0)
+			{
+				return;
+			}
+		}
+		// Write only while the stimulus port FIFO has room, the rest goes on the next call
+		while(sink->txIndex < sink->txLength)
+		{
+			if(ITM->PORT[0].u32 == 0)
+			{
+				return;
+			}
+			ITM->PORT[0].u8 = sink->txFrame[sink->txIndex++];
+		}
+	}
+}
+#endif
+
+
+//-------------- PRIVATE FUNCTIONS --------------//
+void buttons_TraceCallback(Button* button, ButtonTraceType type, uint8_t value, uint32_t timestamp)
+{
+	buttons_TraceRecord(activeSink, button, type, value, timestamp);
+}
+
+void buttons_TraceSerialise(uint8_t* data, uint8_t type, uint8_t button, uint8_t value, uint32_t timestamp)
+{
+	data[0] = BUTTONS_TRACE_SYNC;
+	data[1] = type;
+	data[2] = button;
+	data[3] = value;
+	data[4] = timestamp & 0xFF;
+	data[5] = (timestamp >> 8) & 0xFF;
+	data[6] = (timestamp >> 16) & 0xFF;
+	data[7] = timestamp >> 24;
+}
+
+// The queue holding the oldest pending record, NULL when all are empty
+ButtonTraceQueue* buttons_TraceOldestQueue(ButtonTraceSink* sink)
+{
+	ButtonTraceQueue* oldest = NULL;
+	for(uint8_t i=0; i<BUTTONS_TRACE_CORES; i++)
+	{
+		ButtonTraceQueue* queue = &sink->queues[i];
+		if(queue->tail == queue->head)
+		{
+			continue;
+		}
+		TRACE_FENCE();
+		if(oldest == NULL ||
+			(int32_t)(queue->queue[queue->tail].timestamp - oldest->queue[oldest->tail].timestamp) < 0)
+		{
+			oldest = queue;
+		}
+	}
+	return oldest;
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
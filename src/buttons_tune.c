@@ -0,0 +1,258 @@
+/*
+ * buttons_tune.c
+ *
+ * Debounce timing advisor over recorded edge traces. See buttons_tune.h.
+ */
+
+#include "buttons_tune.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Helper Macros */
+#define TRUE	1
+#define FALSE	0
+
+// Replay of one trace, the context of the press listener
+typedef struct
+{
+	const ButtonTrace* trace;
+	ButtonGroup* group;
+	ButtonTuneResult* result;
+	size_t next;						// first real press not yet matched or missed
+	size_t down;						// first real press not yet released
+} ButtonTuneReplay;
+
+//-------------- PRIVATE FUNCTION PROTOTYPES --------------//
+void buttons_TuneClassify(ButtonListener* listener, Button* button, ButtonState state);
+uint8_t buttons_TuneSwitchDown(ButtonTuneReplay* replay, uint32_t now);
+uint8_t buttons_TuneBeats(const ButtonTuneResult* a, const ButtonTuneResult* b);
+uint8_t buttons_TuneTied(const ButtonTuneResult* a, const ButtonTuneResult* b);
+
+
+//-------------- PUBLIC FUNCTIONS --------------//
+void buttons_TuneEvaluate(const ButtonTimingProfile* candidate, const ButtonTrace* traces, uint16_t numTraces,
+							Button* scratch, ButtonTuneResult* result)
+{
+	const ButtonConfig config = {.profiles = candidate, .numProfiles = 1};
+	ButtonGroup group;
+	ButtonListener classifier;
+	ButtonTuneReplay replay;
+
+	result->presses = 0;
+	result->falsePresses = 0;
+	result->missedPresses = 0;
+	result->doublePressErrors = 0;
+	result->falseReleases = 0;
+	result->rejectedEdges = 0;
+	result->matchedPresses = 0;
+	result->latencyTotal = 0;
+	result->latencyMax = 0;
+
+	for(uint16_t t=0; t<numTraces; t++)
+	{
+		// Every trace starts from a released button and an idle virtual clock
+		scratch->handler = NULL;
+		scratch->source = ButtonVirtual;
+		scratch->profile = 0;
+		scratch->debounceBypass = FALSE;
+		buttons_Init(scratch);
+		scratch->timerTriggered = 0;
+		scratch->accelerationTrigger = FALSE;
+		buttons_InitGroup(&group, scratch, 1, NULL);
+		buttons_SetGroupConfig(&group, &config);
+
+		replay.trace = &traces[t];
+		replay.group = &group;
+		replay.result = result;
+		replay.next = 0;
+		replay.down = 0;
+		classifier.stateMask = BUTTON_STATE_MASK(Pressed) | BUTTON_STATE_MASK(DoublePressed) |
+								BUTTON_STATE_MASK(Released) | BUTTON_STATE_MASK(DoublePressReleased) |
+								BUTTON_STATE_MASK(HeldReleased);
+		classifier.oneShot = FALSE;
+		classifier.callback = buttons_TuneClassify;
+		classifier.context = &replay;
+		buttons_AddGroupListener(&group, &classifier);
+
+		buttons_InjectEdges(&group, traces[t].edges, traces[t].numEdges);
+
+		// Real presses after the last produced one were all missed
+		result->missedPresses += (uint32_t)(traces[t].numPresses - replay.next);
+		result->rejectedEdges += buttons_GetGroupDebounceFails(&group);
+	}
+}
+
+uint16_t buttons_TuneRecommend(const ButtonTimingProfile* candidates, uint16_t numCandidates,
+							const ButtonTrace* traces, uint16_t numTraces,
+							Button* scratch, ButtonTuneResult* results)
+{
+	for(uint16_t c=0; c<numCandidates; c++)
+	{
+		buttons_TuneEvaluate(&candidates[c], traces, numTraces, scratch, &results[c]);
+	}
+	return buttons_TuneSelect(candidates, results, numCandidates);
+}
+
+uint16_t buttons_TuneSelect(const ButtonTimingProfile* candidates, const ButtonTuneResult* results, uint16_t numCandidates)
+{
+	// Fewest errors first, then the lowest latency, then the least lockout, then the shortest double press wait
+	uint16_t best = 0;
+	for(uint16_t c=1; c<numCandidates; c++)
+	{
+		uint32_t errors = buttons_TuneErrors(&results[c]);
+		uint32_t bestErrors = buttons_TuneErrors(&results[best]);
+		uint32_t latency = buttons_TuneMeanLatency(&results[c]);
+		uint32_t bestLatency = buttons_TuneMeanLatency(&results[best]);
+		uint32_t window = (uint32_t)candidates[c].debounceLowToHigh + candidates[c].debounceHighToLow;
+		uint32_t bestWindow = (uint32_t)candidates[best].debounceLowToHigh + candidates[best].debounceHighToLow;
+		if(errors != bestErrors)
+		{
+			if(errors < bestErrors)
+				best = c;
+		}
+		else if(latency != bestLatency)
+		{
+			if(latency < bestLatency)
+				best = c;
+		}
+		else if(window != bestWindow)
+		{
+			if(window < bestWindow)
+				best = c;
+		}
+		else if(candidates[c].doublePressTime < candidates[best].doublePressTime)
+		{
+			best = c;
+		}
+	}
+	return best;
+}
+
+uint16_t buttons_TuneParetoFront(const ButtonTuneResult* results, uint16_t numCandidates, uint8_t* front)
+{
+	// A candidate is on the front unless another one is at least as good on every axis and better on one.
+	// Of candidates with the same results only the first is kept
+	uint16_t count = 0;
+	for(uint16_t c=0; c<numCandidates; c++)
+	{
+		front[c] = TRUE;
+		for(uint16_t o=0; o<numCandidates; o++)
+		{
+			if(o != c && (buttons_TuneBeats(&results[o], &results[c]) || (o < c && buttons_TuneTied(&results[o], &results[c]))))
+			{
+				front[c] = FALSE;
+				break;
+			}
+		}
+		count += front[c];
+	}
+	return count;
+}
+
+uint32_t buttons_TuneErrors(const ButtonTuneResult* result)
+{
+	return result->falsePresses + result->missedPresses + result->doublePressErrors + result->falseReleases;
+}
+
+uint32_t buttons_TuneMeanLatency(const ButtonTuneResult* result)
+{
+	// In 1/16 ms, so sub-millisecond differences between candidates still rank.
+	// Without a single matched press the latency is the worst, not unknown
+	if(result->matchedPresses == 0)
+	{
+		return UINT32_MAX;
+	}
+	return (uint32_t)((result->latencyTotal << 4) / result->matchedPresses);
+}
+
+
+//-------------- PRIVATE FUNCTIONS --------------//
+void buttons_TuneClassify(ButtonListener* listener, Button* button, ButtonState state)
+{
+	ButtonTuneReplay* replay = (ButtonTuneReplay*)listener->context;
+	const ButtonTrace* trace = replay->trace;
+	ButtonTuneResult* result = replay->result;
+	uint32_t now = replay->group->virtualTime;
+	(void)button;
+
+	if(state != Pressed && state != DoublePressed)
+	{
+		if(buttons_TuneSwitchDown(replay, now))
+		{
+			result->falseReleases++;
+		}
+		return;
+	}
+
+	result->presses++;
+
+	// Real presses too long before this one were missed
+	while(replay->next < trace->numPresses &&
+			(int32_t)(now - trace->presses[replay->next].timestamp) > BUTTONS_TUNE_MATCH_TIME)
+	{
+		replay->next++;
+		result->missedPresses++;
+	}
+
+	// The next real press must have started already for this to be it
+	if(replay->next == trace->numPresses || (int32_t)(now - trace->presses[replay->next].timestamp) < 0)
+	{
+		result->falsePresses++;
+		return;
+	}
+
+	const ButtonTunePress* press = &trace->presses[replay->next++];
+	uint32_t latency = now - press->timestamp;
+	result->matchedPresses++;
+	result->latencyTotal += latency;
+	if(latency > result->latencyMax)
+	{
+		result->latencyMax = latency;
+	}
+	if(press->doublePress != BUTTONS_TUNE_ANY_PRESS && press->doublePress != (state == DoublePressed))
+	{
+		result->doublePressErrors++;
+	}
+}
+
+uint8_t buttons_TuneSwitchDown(ButtonTuneReplay* replay, uint32_t now)
+{
+	// Events come in time order, so presses released before this one never matter again
+	const ButtonTrace* trace = replay->trace;
+	while(replay->down < trace->numPresses &&
+			(int32_t)(now - (trace->presses[replay->down].timestamp + trace->presses[replay->down].duration)) >= 0)
+	{
+		replay->down++;
+	}
+	if(replay->down == trace->numPresses)
+	{
+		return FALSE;
+	}
+	const ButtonTunePress* press = &trace->presses[replay->down];
+	return press->duration != 0 && (int32_t)(now - press->timestamp) >= 0;
+}
+
+uint8_t buttons_TuneBeats(const ButtonTuneResult* a, const ButtonTuneResult* b)
+{
+	uint32_t falseA = a->falsePresses + a->falseReleases;
+	uint32_t falseB = b->falsePresses + b->falseReleases;
+	uint32_t latencyA = buttons_TuneMeanLatency(a);
+	uint32_t latencyB = buttons_TuneMeanLatency(b);
+	if(falseA > falseB || a->missedPresses > b->missedPresses || latencyA > latencyB)
+	{
+		return FALSE;
+	}
+	return falseA < falseB || a->missedPresses < b->missedPresses || latencyA < latencyB;
+}
+
+uint8_t buttons_TuneTied(const ButtonTuneResult* a, const ButtonTuneResult* b)
+{
+	return a->falsePresses + a->falseReleases == b->falsePresses + b->falseReleases &&
+			a->missedPresses == b->missedPresses && buttons_TuneMeanLatency(a) == buttons_TuneMeanLatency(b);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,128 @@
+/*
+ * boot_test.c
+ *
+ * Boots a group from a descriptor table with buttons_InitGroup() while some switches
+ * are already held, by driving their host pins before the call. Checks that the held
+ * switches report neither a press nor, when let go, a release, that they behave
+ * normally afterwards, and that the other buttons are unaffected. Exits non-zero on
+ * the first failure. See README.md for building.
+ */
+
+#include "buttons.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_BUTTONS	4
+#define TEST_MAX_EVENTS	16
+
+typedef struct
+{
+	uint8_t button;
+	ButtonState state;
+} TestEvent;
+
+// Held at boot: 0 (active low) and 2 (active high). Free: 1 (active low) and 3 (active high)
+static const ButtonDesc table[TEST_BUTTONS] = {
+	{ Momentary, ActiveLow, NULL, 2, ButtonPhysical, 0, 0 },
+	{ Momentary, ActiveLow, NULL, 3, ButtonPhysical, 0, 0 },
+	{ Momentary, ActiveHigh, NULL, 4, ButtonPhysical, 0, 0 },
+	{ Momentary, ActiveHigh, NULL, 5, ButtonPhysical, 0, 0 },
+};
+
+static Button buttons[TEST_BUTTONS];
+static ButtonGroup group;
+static ButtonListener listener;
+
+static TestEvent events[TEST_MAX_EVENTS];
+static uint16_t numEvents;
+
+static void test_Listener(ButtonListener* l, Button* button, ButtonState state)
+{
+	(void)l;
+	if(numEvents < TEST_MAX_EVENTS)
+	{
+		events[numEvents].button = (uint8_t)(button - buttons);
+		events[numEvents].state = state;
+		numEvents++;
+	}
+}
+
+// Sets a pin at the given time and delivers its edge as the pin interrupt would
+static void test_Edge(uint8_t button, int level, uint32_t ms)
+{
+	host_SetMillis(ms);
+	host_SetPin((uint8_t)table[button].pin, level);
+	buttons_ExtiGpioCallback(&buttons[button], ButtonEmulateNone);
+}
+
+static void test_Expect(const char* name, const TestEvent* expected, uint16_t numExpected)
+{
+	buttons_GroupTriggerPoll(&group);
+	uint8_t ok = numEvents == numExpected;
+	for(uint16_t i=0; ok && i<numExpected; i++)
+	{
+		ok = events[i].button == expected[i].button && events[i].state == expected[i].state;
+	}
+	if(!ok)
+	{
+		printf("FAIL %s\n", name);
+		for(uint16_t i=0; i<numEvents; i++)
+		{
+			printf("  got button %u state %d\n", events[i].button, events[i].state);
+		}
+		exit(1);
+	}
+	printf("ok   %s\n", name);
+	numEvents = 0;
+}
+
+int main(void)
+{
+	static const TestEvent pressedAgain[] = {
+		{ 0, Pressed }, { 2, Pressed },
+	};
+	static const TestEvent releasedAgain[] = {
+		{ 0, Released }, { 2, Released },
+	};
+	static const TestEvent free[] = {
+		{ 1, Pressed }, { 3, Pressed }, { 1, Released }, { 3, Released },
+	};
+
+	// Switches 0 and 2 are down before the group is initialised
+	host_SetMillis(1000);
+	host_SetPin(2, LOW);
+	host_SetPin(4, HIGH);
+	buttons_InitGroup(&group, buttons, TEST_BUTTONS, table);
+	listener.stateMask = 0xFFFF;
+	listener.callback = test_Listener;
+	buttons_AddGroupListener(&group, &listener);
+	test_Expect("no press for switches held at boot", NULL, 0);
+
+	if(!buttons_IsPressed(&buttons[0]) || !buttons_IsPressed(&buttons[2]) ||
+		buttons_IsPressed(&buttons[1]) || buttons_IsPressed(&buttons[3]))
+	{
+		printf("FAIL switches held at boot not seeded as pressed\n");
+		return 1;
+	}
+
+	test_Edge(0, HIGH, 1200);
+	test_Edge(2, LOW, 1210);
+	test_Expect("no release when they are let go", NULL, 0);
+
+	// Past the double press window, so the next presses are plain presses
+	test_Edge(0, LOW, 2000);
+	test_Edge(2, HIGH, 2010);
+	test_Expect("pressed normally afterwards", pressedAgain, sizeof(pressedAgain) / sizeof(pressedAgain[0]));
+	test_Edge(0, HIGH, 2100);
+	test_Edge(2, LOW, 2110);
+	test_Expect("released normally afterwards", releasedAgain, sizeof(releasedAgain) / sizeof(releasedAgain[0]));
+
+	test_Edge(1, LOW, 3000);
+	test_Edge(3, HIGH, 3010);
+	buttons_GroupTriggerPoll(&group);
+	test_Edge(1, HIGH, 3100);
+	test_Edge(3, LOW, 3110);
+	test_Expect("free switches unaffected", free, sizeof(free) / sizeof(free[0]));
+	return 0;
+}
@@ -0,0 +1,411 @@
+/*
+ * fleet_sim.c
+ *
+ * Simulates a fleet of devices, each a ButtonGroup fed a recorded usage pattern with
+ * buttons_InjectEdges(), sharded across a work-stealing thread pool.
+ *
+ * Every device gets a recording of taps, double presses, long holds and bouncing
+ * presses, generated from its index so runs are repeatable. Each worker owns a range
+ * of devices and takes them from the front, and an idle worker steals the back half
+ * of the busiest looking range it finds. Devices only touch their own group, each
+ * worker keeps its own statistics and virtual clock (the host shim's millis() is per
+ * thread), and the totals are merged after the run. Per event state it reports the
+ * count and the virtual latency from the edge that caused the event, plus the wall
+ * time per device. The run is repeated with 1, 2, 4... threads up to the requested
+ * count, checking every run produces the same events, and reports the speedup.
+ *
+ * Usage: fleet_sim [devices] [threads] [edges per device]. See README.md for building.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "buttons.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SIM_BUTTONS		8
+#define SIM_STATES		(PressureChanged + 1)
+#define SIM_HOLD_TIME	1000
+#define SIM_CHUNK		64
+#define SIM_MAX_THREADS	256
+#define SIM_WALL_BUCKETS	32
+
+typedef struct
+{
+	uint64_t events[SIM_STATES];
+	uint64_t latencySum[SIM_STATES];		// ms of virtual time from the causing edge
+	uint32_t latencyMax[SIM_STATES];
+	uint64_t edges;
+	uint64_t debounceFails;
+	uint64_t devices;
+	uint64_t steals;
+	uint64_t wallBuckets[SIM_WALL_BUCKETS];	// device wall time, log2 ns
+} SimStats;
+
+typedef struct
+{
+	ButtonGroup group;
+	Button buttons[SIM_BUTTONS];
+	ButtonListener listener;
+	ButtonEdge* recording;
+	size_t numEdges;
+	SimStats* stats;
+} SimDevice;
+
+typedef struct
+{
+	pthread_mutex_t lock;
+	size_t next;
+	size_t end;
+} SimQueue;
+
+typedef struct
+{
+	pthread_t thread;
+	uint16_t index;
+	SimStats stats;
+} SimWorker;
+
+static SimDevice* devices;
+static size_t numDevices;
+static SimQueue queues[SIM_MAX_THREADS];
+static SimWorker workers[SIM_MAX_THREADS];
+static uint16_t numWorkers;
+
+static double sim_Seconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+//-------------- RECORDINGS --------------//
+static uint32_t sim_Random(uint32_t* seed)
+{
+	// xorshift32, one generator per device so recordings don't depend on threads
+	uint32_t x = *seed;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*seed = x;
+	return x;
+}
+
+static void sim_Edge(SimDevice* device, size_t maxEdges, uint16_t button, uint8_t level, uint32_t timestamp)
+{
+	if(device->numEdges < maxEdges)
+	{
+		ButtonEdge* edge = &device->recording[device->numEdges++];
+		edge->button = button;
+		edge->level = level;
+		edge->timestamp = timestamp;
+	}
+}
+
+static void sim_Record(SimDevice* device, size_t index, size_t maxEdges)
+{
+	uint32_t seed = (uint32_t)(index * 2654435761u) | 1;
+	uint32_t time = 1000;
+
+	device->recording = (ButtonEdge*)malloc(maxEdges * sizeof(ButtonEdge));
+	if(device->recording == NULL)
+	{
+		printf("out of memory\n");
+		exit(1);
+	}
+	device->numEdges = 0;
+	while(device->numEdges < maxEdges)
+	{
+		uint16_t button = (uint16_t)(sim_Random(&seed) % SIM_BUTTONS);
+		switch(sim_Random(&seed) % 4)
+		{
+		case 0:		// tap
+			sim_Edge(device, maxEdges, button, 1, time);
+			sim_Edge(device, maxEdges, button, 0, time + 40 + sim_Random(&seed) % 160);
+			break;
+		case 1:		// double press
+			sim_Edge(device, maxEdges, button, 1, time);
+			sim_Edge(device, maxEdges, button, 0, time + 80);
+			sim_Edge(device, maxEdges, button, 1, time + 80 + 60 + sim_Random(&seed) % 100);
+			sim_Edge(device, maxEdges, button, 0, time + 320);
+			break;
+		case 2:		// long hold
+			sim_Edge(device, maxEdges, button, 1, time);
+			sim_Edge(device, maxEdges, button, 0, time + 1200 + sim_Random(&seed) % 1800);
+			break;
+		default:	// press with contact bounce
+			sim_Edge(device, maxEdges, button, 1, time);
+			sim_Edge(device, maxEdges, button, 0, time + 1 + sim_Random(&seed) % 3);
+			sim_Edge(device, maxEdges, button, 1, time + 5);
+			sim_Edge(device, maxEdges, button, 0, time + 150);
+			break;
+		}
+		time += 3500 + sim_Random(&seed) % 2000;
+	}
+}
+
+//-------------- SIMULATION --------------//
+static void sim_Listener(ButtonListener* listener, Button* button, ButtonState state)
+{
+	SimDevice* device = (SimDevice*)listener->context;
+	SimStats* stats = device->stats;
+	// lastTime is the accepted edge that led to the event (holds don't move it)
+	uint32_t latency = device->group.virtualTime - button->lastTime;
+	stats->events[state]++;
+	stats->latencySum[state] += latency;
+	if(latency > stats->latencyMax[state])
+	{
+		stats->latencyMax[state] = latency;
+	}
+}
+
+static void sim_Device(SimDevice* device, SimStats* stats)
+{
+	double start = sim_Seconds();
+
+	for(uint16_t i=0; i<SIM_BUTTONS; i++)
+	{
+		memset(&device->buttons[i], 0, sizeof(Button));
+		buttons_Init(&device->buttons[i]);
+	}
+	buttons_InitGroup(&device->group, device->buttons, SIM_BUTTONS, NULL);
+	memset(&device->listener, 0, sizeof(device->listener));
+	device->listener.stateMask = 0xFFFF;
+	device->listener.callback = sim_Listener;
+	device->listener.context = device;
+	buttons_AddGroupListener(&device->group, &device->listener);
+	device->stats = stats;
+
+	// The thread's own clock follows the device being simulated
+	for(size_t i=0; i<device->numEdges; i+=SIM_CHUNK)
+	{
+		size_t n = device->numEdges - i < SIM_CHUNK ? device->numEdges - i : SIM_CHUNK;
+		host_SetMillis(device->recording[i + n - 1].timestamp);
+		buttons_InjectEdges(&device->group, &device->recording[i], n);
+	}
+	uint32_t end = device->recording[device->numEdges - 1].timestamp + 10000;
+	host_SetMillis(end);
+	buttons_AdvanceVirtualTime(&device->group, end);
+
+	stats->edges += device->numEdges;
+	stats->debounceFails += buttons_GetGroupDebounceFails(&device->group);
+	stats->devices++;
+	uint64_t ns = (uint64_t)((sim_Seconds() - start) * 1e9);
+	uint8_t bucket = 0;
+	while(ns > 1 && bucket < SIM_WALL_BUCKETS - 1)
+	{
+		ns >>= 1;
+		bucket++;
+	}
+	stats->wallBuckets[bucket]++;
+}
+
+//-------------- WORK STEALING POOL --------------//
+static uint8_t sim_Take(SimQueue* queue, size_t* device)
+{
+	uint8_t taken = 0;
+	pthread_mutex_lock(&queue->lock);
+	if(queue->next < queue->end)
+	{
+		*device = queue->next++;
+		taken = 1;
+	}
+	pthread_mutex_unlock(&queue->lock);
+	return taken;
+}
+
+static uint8_t sim_Steal(SimWorker* worker)
+{
+	// Visit the others in turn and take the back half of the first non-empty range
+	for(uint16_t k=1; k<numWorkers; k++)
+	{
+		SimQueue* victim = &queues[(worker->index + k) % numWorkers];
+		size_t begin = 0, end = 0;
+		pthread_mutex_lock(&victim->lock);
+		size_t remaining = victim->end - victim->next;
+		if(remaining > 0)
+		{
+			end = victim->end;
+			victim->end -= (remaining + 1) / 2;
+			begin = victim->end;
+		}
+		pthread_mutex_unlock(&victim->lock);
+		if(end > begin)
+		{
+			SimQueue* own = &queues[worker->index];
+			pthread_mutex_lock(&own->lock);
+			own->next = begin;
+			own->end = end;
+			pthread_mutex_unlock(&own->lock);
+			worker->stats.steals++;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void* sim_Worker(void* arg)
+{
+	SimWorker* worker = (SimWorker*)arg;
+	size_t device;
+	for(;;)
+	{
+		while(sim_Take(&queues[worker->index], &device))
+		{
+			sim_Device(&devices[device], &worker->stats);
+		}
+		if(!sim_Steal(worker))
+		{
+			return NULL;
+		}
+	}
+}
+
+static void sim_Merge(SimStats* total, const SimStats* stats)
+{
+	for(uint8_t s=0; s<SIM_STATES; s++)
+	{
+		total->events[s] += stats->events[s];
+		total->latencySum[s] += stats->latencySum[s];
+		if(stats->latencyMax[s] > total->latencyMax[s])
+		{
+			total->latencyMax[s] = stats->latencyMax[s];
+		}
+	}
+	total->edges += stats->edges;
+	total->debounceFails += stats->debounceFails;
+	total->devices += stats->devices;
+	total->steals += stats->steals;
+	for(uint8_t b=0; b<SIM_WALL_BUCKETS; b++)
+	{
+		total->wallBuckets[b] += stats->wallBuckets[b];
+	}
+}
+
+static double sim_Run(uint16_t threads, SimStats* total)
+{
+	numWorkers = threads;
+	for(uint16_t w=0; w<threads; w++)
+	{
+		// Contiguous shards to start with, stealing evens out the rest
+		queues[w].next = numDevices * w / threads;
+		queues[w].end = numDevices * (w + 1) / threads;
+		memset(&workers[w].stats, 0, sizeof(SimStats));
+		workers[w].index = w;
+	}
+
+	double start = sim_Seconds();
+	for(uint16_t w=0; w<threads; w++)
+	{
+		if(pthread_create(&workers[w].thread, NULL, sim_Worker, &workers[w]) != 0)
+		{
+			printf("can't start thread %u\n", w);
+			exit(1);
+		}
+	}
+	for(uint16_t w=0; w<threads; w++)
+	{
+		pthread_join(workers[w].thread, NULL);
+	}
+	double seconds = sim_Seconds() - start;
+
+	memset(total, 0, sizeof(SimStats));
+	for(uint16_t w=0; w<threads; w++)
+	{
+		sim_Merge(total, &workers[w].stats);
+	}
+	return seconds;
+}
+
+static void sim_Report(const SimStats* stats)
+{
+	static const char* const names[SIM_STATES] = {
+		"Pressed", "DoublePressed", "Released", "DoublePressReleased", "Held",
+		"HeldReleased", "Cleared", "HeldRepeat", "HoldProgress", "PressureChanged"
+	};
+	printf("%llu devices, %llu edges, %llu rejected by debounce\n", (unsigned long long)stats->devices,
+			(unsigned long long)stats->edges, (unsigned long long)stats->debounceFails);
+	printf("event                  count  mean latency ms  max latency ms\n");
+	for(uint8_t s=0; s<SIM_STATES; s++)
+	{
+		if(stats->events[s] == 0)
+		{
+			continue;
+		}
+		printf("%-20s %8llu  %15.1f  %14u\n", names[s], (unsigned long long)stats->events[s],
+				(double)stats->latencySum[s] / stats->events[s], stats->latencyMax[s]);
+	}
+	printf("wall time per device:");
+	for(uint8_t b=0; b<SIM_WALL_BUCKETS; b++)
+	{
+		if(stats->wallBuckets[b] != 0)
+		{
+			printf("  <%lluus %llu", (unsigned long long)((2ULL << b) / 1000), (unsigned long long)stats->wallBuckets[b]);
+		}
+	}
+	printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+	numDevices = argc > 1 ? strtoul(argv[1], NULL, 0) : 4096;
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	uint16_t maxThreads = (uint16_t)(argc > 2 ? strtoul(argv[2], NULL, 0) : (unsigned long)(cores > 0 ? cores : 1));
+	size_t edgesPerDevice = argc > 3 ? strtoul(argv[3], NULL, 0) : 1024;
+	if(numDevices == 0 || edgesPerDevice == 0 || maxThreads == 0 || maxThreads > SIM_MAX_THREADS)
+	{
+		printf("usage: fleet_sim [devices] [threads <= %u] [edges per device]\n", SIM_MAX_THREADS);
+		return 1;
+	}
+
+	buttons_SetHoldTime(SIM_HOLD_TIME);
+	devices = (SimDevice*)calloc(numDevices, sizeof(SimDevice));
+	if(devices == NULL)
+	{
+		printf("out of memory\n");
+		return 1;
+	}
+	for(size_t i=0; i<numDevices; i++)
+	{
+		sim_Record(&devices[i], i, edgesPerDevice);
+	}
+	for(uint16_t w=0; w<SIM_MAX_THREADS; w++)
+	{
+		pthread_mutex_init(&queues[w].lock, NULL);
+	}
+
+	SimStats reference;
+	double baseline = 0;
+	for(uint16_t threads=1; ; threads*=2)
+	{
+		if(threads > maxThreads)
+		{
+			threads = maxThreads;
+		}
+		SimStats total;
+		double seconds = sim_Run(threads, &total);
+		if(threads == 1)
+		{
+			baseline = seconds;
+			reference = total;
+			sim_Report(&total);
+		}
+		else if(memcmp(total.events, reference.events, sizeof(total.events)) != 0 ||
+				memcmp(total.latencySum, reference.latencySum, sizeof(total.latencySum)) != 0)
+		{
+			printf("%u threads produced different events\n", threads);
+			return 1;
+		}
+		printf("%3u threads: %7.2f M edges/s, speedup %5.2f, %llu steals\n", threads,
+				total.edges / seconds / 1e6, baseline / seconds, (unsigned long long)total.steals);
+		if(threads == maxThreads)
+		{
+			break;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,190 @@
+/*
+ * fsr_test.c
+ *
+ * Feeds synthetic ADC streams to buttons_FsrProcessAdc() and checks the events
+ * the pads produce: press and release at the thresholds, no chatter inside the
+ * hysteresis band, and rate limited PressureChanged events. Exits non-zero on
+ * the first failure. See README.md for building.
+ */
+
+#include "buttons_fsr.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_PADS		2
+#define TEST_MAX_EVENTS	32
+
+typedef struct
+{
+	uint8_t pad;
+	ButtonState state;
+	uint16_t pressure;
+} TestEvent;
+
+static Button buttons[TEST_PADS];
+static ButtonFsr pads[TEST_PADS];
+static ButtonListener listeners[TEST_PADS];
+static TestEvent events[TEST_MAX_EVENTS];
+static uint16_t numEvents;
+
+static void test_Listener(ButtonListener* listener, Button* button, ButtonState state)
+{
+	ButtonFsr* pad = (ButtonFsr*)listener->context;
+	if(numEvents < TEST_MAX_EVENTS)
+	{
+		events[numEvents].pad = (uint8_t)(pad - pads);
+		events[numEvents].state = state;
+		events[numEvents].pressure = buttons_FsrGetPressure(pad);
+		numEvents++;
+	}
+	(void)button;
+}
+
+static void test_Reset(void)
+{
+	memset(buttons, 0, sizeof(buttons));
+	memset(listeners, 0, sizeof(listeners));
+	for(uint8_t i=0; i<TEST_PADS; i++)
+	{
+		buttons_Init(&buttons[i]);
+		pads[i].button = &buttons[i];
+		pads[i].pressThreshold = 600;
+		pads[i].releaseThreshold = 400;
+		pads[i].minDelta = 50;
+		pads[i].minInterval = 10;
+		buttons_FsrInit(&pads[i]);
+
+		listeners[i].stateMask = BUTTON_STATE_MASK(Pressed) | BUTTON_STATE_MASK(Released) |
+									BUTTON_STATE_MASK(PressureChanged);
+		listeners[i].callback = test_Listener;
+		listeners[i].context = &pads[i];
+		buttons_AddListener(&buttons[i], &listeners[i]);
+	}
+	numEvents = 0;
+}
+
+// Plays one sample per ms for every pad, polling after each scan like the main loop would
+static void test_Play(const uint16_t stream[][TEST_PADS], uint16_t length, uint32_t startTime)
+{
+	for(uint16_t t=0; t<length; t++)
+	{
+		host_SetMillis(startTime + t);
+		buttons_FsrProcessAdc(pads, TEST_PADS, stream[t], startTime + t);
+		buttons_TriggerPoll(buttons, TEST_PADS);
+	}
+}
+
+static void test_Expect(const char* name, const TestEvent* expected, uint16_t numExpected)
+{
+	uint8_t ok = numEvents == numExpected;
+	for(uint16_t i=0; ok && i<numExpected; i++)
+	{
+		ok = events[i].pad == expected[i].pad && events[i].state == expected[i].state &&
+				events[i].pressure == expected[i].pressure;
+	}
+	if(!ok)
+	{
+		printf("FAIL %s\n", name);
+		for(uint16_t i=0; i<numEvents; i++)
+		{
+			printf("  got pad %u state %d pressure %u\n", events[i].pad, events[i].state, events[i].pressure);
+		}
+		exit(1);
+	}
+	printf("ok   %s\n", name);
+}
+
+static void test_PressRelease(void)
+{
+	static const uint16_t stream[][TEST_PADS] = {
+		{ 0, 0 }, { 300, 0 }, { 599, 0 }, { 600, 0 }, { 610, 0 },
+		{ 420, 0 }, { 399, 0 }, { 0, 0 },
+	};
+	static const TestEvent expected[] = {
+		{ 0, Pressed, 600 },
+		{ 0, Released, 399 },
+	};
+	test_Reset();
+	test_Play(stream, sizeof(stream) / sizeof(stream[0]), 1000);
+	test_Expect("press and release at the thresholds", expected, sizeof(expected) / sizeof(expected[0]));
+}
+
+static void test_Hysteresis(void)
+{
+	// Noise straddling the press threshold, then the release threshold
+	static const uint16_t stream[][TEST_PADS] = {
+		{ 590, 0 }, { 605, 0 }, { 595, 0 }, { 602, 0 }, { 598, 0 },
+		{ 405, 0 }, { 395, 0 }, { 405, 0 }, { 395, 0 }, { 590, 0 },
+	};
+	static const TestEvent expected[] = {
+		{ 0, Pressed, 605 },
+		{ 0, Released, 395 },
+	};
+	test_Reset();
+	test_Play(stream, sizeof(stream) / sizeof(stream[0]), 2000);
+	test_Expect("no chatter inside the hysteresis band", expected, sizeof(expected) / sizeof(expected[0]));
+}
+
+static void test_Aftertouch(void)
+{
+	// A ramp one step per ms: changes of 50 or more, at most once per 10 ms
+	uint16_t stream[40][TEST_PADS];
+	for(uint16_t t=0; t<40; t++)
+	{
+		stream[t][0] = 0;
+		stream[t][1] = (uint16_t)(600 + t * 10);
+	}
+	static const TestEvent expected[] = {
+		{ 1, Pressed, 600 },
+		{ 1, PressureChanged, 700 },
+		{ 1, PressureChanged, 800 },
+		{ 1, PressureChanged, 900 },
+	};
+	test_Reset();
+	test_Play((const uint16_t (*)[TEST_PADS])stream, 40, 3000);
+	test_Expect("pressure changes limited in size and rate", expected, sizeof(expected) / sizeof(expected[0]));
+}
+
+static void test_SmallChanges(void)
+{
+	// Slow drift below minDelta never reports, however long it lasts
+	uint16_t stream[100][TEST_PADS];
+	for(uint16_t t=0; t<100; t++)
+	{
+		stream[t][0] = (uint16_t)(700 + (t & 1) * 49);
+		stream[t][1] = 0;
+	}
+	static const TestEvent expected[] = {
+		{ 0, Pressed, 700 },
+	};
+	test_Reset();
+	test_Play((const uint16_t (*)[TEST_PADS])stream, 100, 4000);
+	test_Expect("changes below minDelta are ignored", expected, sizeof(expected) / sizeof(expected[0]));
+}
+
+static void test_Independent(void)
+{
+	static const uint16_t stream[][TEST_PADS] = {
+		{ 700, 0 }, { 700, 700 }, { 0, 700 }, { 0, 0 },
+	};
+	static const TestEvent expected[] = {
+		{ 0, Pressed, 700 },
+		{ 1, Pressed, 700 },
+		{ 0, Released, 0 },
+		{ 1, Released, 0 },
+	};
+	test_Reset();
+	test_Play(stream, sizeof(stream) / sizeof(stream[0]), 5000);
+	test_Expect("pads are independent", expected, sizeof(expected) / sizeof(expected[0]));
+}
+
+int main(void)
+{
+	test_PressRelease();
+	test_Hysteresis();
+	test_Aftertouch();
+	test_SmallChanges();
+	test_Independent();
+	return 0;
+}
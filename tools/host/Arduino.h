@@ -0,0 +1,45 @@
+/*
+ * Arduino.h
+ *
+ * Minimal Arduino API for building the library on a Linux host with
+ * -DFRAMEWORK_ARDUINO=1 -Itools/host. Time is virtual and per thread: it only
+ * moves when set with host_SetMillis(), so host runs are deterministic and each
+ * thread can simulate its own device.
+ */
+#ifndef HOST_ARDUINO_H_
+#define HOST_ARDUINO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define INPUT			0x0
+#define OUTPUT			0x1
+#define INPUT_PULLUP	0x2
+#define HIGH			0x1
+#define LOW				0x0
+
+unsigned long millis(void);
+unsigned long micros(void);
+int digitalRead(uint8_t pin);
+void pinMode(uint8_t pin, uint8_t mode);
+void noInterrupts(void);
+void interrupts(void);
+
+// Nothing interrupts a host thread, so trace records need no lock
+#define BUTTONS_TRACE_LOCK()
+#define BUTTONS_TRACE_UNLOCK()
+
+// Host controls. A pin set with host_SetPin() keeps its level through pinMode(),
+// like a switch held while the firmware boots; other pins float to their pull
+void host_SetMillis(uint32_t ms);
+void host_SetPin(uint8_t pin, int level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_ARDUINO_H_ */
@@ -0,0 +1,56 @@
+/*
+ * host_arduino.c
+ *
+ * Minimal Arduino API for host builds. See Arduino.h.
+ */
+
+#include "Arduino.h"
+
+#define HOST_PINS 256
+
+static _Thread_local uint32_t hostMillis = 0;
+static _Thread_local uint8_t hostPins[HOST_PINS];
+static _Thread_local uint8_t hostPinDriven[HOST_PINS];
+
+unsigned long millis(void)
+{
+	return hostMillis;
+}
+
+unsigned long micros(void)
+{
+	return hostMillis * 1000UL;
+}
+
+int digitalRead(uint8_t pin)
+{
+	return hostPins[pin];
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+	// Undriven pins float to their pull
+	if(!hostPinDriven[pin])
+	{
+		hostPins[pin] = (mode == INPUT_PULLUP) ? HIGH : LOW;
+	}
+}
+
+void noInterrupts(void)
+{
+}
+
+void interrupts(void)
+{
+}
+
+void host_SetMillis(uint32_t ms)
+{
+	hostMillis = ms;
+}
+
+void host_SetPin(uint8_t pin, int level)
+{
+	hostPins[pin] = level ? HIGH : LOW;
+	hostPinDriven[pin] = 1;
+}
@@ -0,0 +1,95 @@
+/*
+ * stm32g4xx_hal.h
+ *
+ * The part of the STM32Cube HAL the library uses, declarations only, so the STM32Cube
+ * build of the library compiles on a host with -DFRAMEWORK_STM32CUBE=1 -DSTM32G4xx
+ * -Itools/host (eg. for tools/ram_check.sh). Nothing here is meant to be linked or run.
+ * There is no DWT or ITM, like a Cortex-M0+ part.
+ */
+#ifndef STM32G4XX_HAL_H_
+#define STM32G4XX_HAL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct
+{
+	volatile uint32_t IDR;
+} GPIO_TypeDef;
+
+typedef struct
+{
+	volatile uint32_t CR1;
+	volatile uint32_t CNT;
+	volatile uint32_t ARR;
+	volatile uint32_t SR;
+} TIM_TypeDef;
+
+typedef struct
+{
+	uint32_t Prescaler;
+	uint32_t Period;
+} TIM_Base_InitTypeDef;
+
+typedef struct
+{
+	TIM_TypeDef* Instance;
+	TIM_Base_InitTypeDef Init;
+} TIM_HandleTypeDef;
+
+typedef struct
+{
+	void* Instance;
+} UART_HandleTypeDef;
+
+typedef struct
+{
+	uint32_t Pin;
+	uint32_t Mode;
+	uint32_t Pull;
+	uint32_t Speed;
+} GPIO_InitTypeDef;
+
+typedef enum
+{
+	HAL_OK,
+	HAL_ERROR,
+	HAL_BUSY
+} HAL_StatusTypeDef;
+
+typedef enum
+{
+	GPIO_PIN_RESET,
+	GPIO_PIN_SET
+} GPIO_PinState;
+
+#define GPIO_MODE_INPUT				0x00000000u
+#define GPIO_MODE_IT_RISING_FALLING	0x10310000u
+#define GPIO_NOPULL					0x00000000u
+#define GPIO_PULLUP					0x00000001u
+#define GPIO_PULLDOWN				0x00000002u
+#define GPIO_SPEED_FREQ_LOW			0x00000000u
+
+#define HAL_UART_MODULE_ENABLED
+
+#define TIM_CR1_CEN					0x00000001u
+#define TIM_IT_UPDATE				0x00000001u
+
+#define __HAL_TIM_CLEAR_FLAG(handle, flag)		((handle)->Instance->SR = ~(flag))
+#define __HAL_TIM_SET_COUNTER(handle, count)	((handle)->Instance->CNT = (count))
+#define __HAL_TIM_SET_AUTORELOAD(handle, reload)	((handle)->Instance->ARR = (reload))
+
+uint32_t HAL_GetTick(void);
+uint32_t HAL_RCC_GetSysClockFreq(void);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* port, uint16_t pin);
+void HAL_GPIO_Init(GPIO_TypeDef* port, GPIO_InitTypeDef* init);
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef* handle);
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef* handle);
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef* handle);
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef* handle, const uint8_t* data, uint16_t size);
+
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void __disable_irq(void);
+
+#endif /* STM32G4XX_HAL_H_ */
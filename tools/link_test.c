@@ -0,0 +1,296 @@
+/*
+ * link_test.c
+ *
+ * Runs a sending and a receiving ButtonLink over a pty pair, the way two boards
+ * share a UART. The sender's frames are written to the master side and read back
+ * from the raw slave side into buttons_LinkParse(). Checks delivery in order,
+ * frames split into single bytes, CRC rejection, resynchronisation after garbage
+ * and stray sync bytes, lost frame counting and receive queue overflow. Exits
+ * non-zero on the first failure. See README.md for building.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "buttons_link.h"
+#include <poll.h>
+#include <pty.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define TEST_BUTTONS	4
+#define TEST_MAX_EVENTS	64
+
+typedef struct
+{
+	uint8_t button;
+	ButtonState state;
+} TestEvent;
+
+static int master;
+static int slave;
+
+static Button senderButtons[TEST_BUTTONS];
+static ButtonGroup senderGroup;
+static ButtonLink sender;
+
+static Button receiverButtons[TEST_BUTTONS];
+static ButtonGroup receiverGroup;
+static ButtonLink receiver;
+static ButtonListener listener;
+
+static TestEvent events[TEST_MAX_EVENTS];
+static uint16_t numEvents;
+
+static void test_Fail(const char* name, const char* reason)
+{
+	printf("FAIL %s: %s\n", name, reason);
+	exit(1);
+}
+
+static void test_Listener(ButtonListener* l, Button* button, ButtonState state)
+{
+	(void)l;
+	if(numEvents < TEST_MAX_EVENTS)
+	{
+		events[numEvents].button = (uint8_t)(button - receiverButtons);
+		events[numEvents].state = state;
+		numEvents++;
+	}
+}
+
+static void test_Reset(void)
+{
+	memset(senderButtons, 0, sizeof(senderButtons));
+	memset(receiverButtons, 0, sizeof(receiverButtons));
+	memset(&listener, 0, sizeof(listener));
+	for(uint8_t i=0; i<TEST_BUTTONS; i++)
+	{
+		buttons_Init(&senderButtons[i]);
+		buttons_Init(&receiverButtons[i]);
+		senderButtons[i].source = ButtonVirtual;
+		receiverButtons[i].source = ButtonVirtual;
+	}
+	buttons_InitGroup(&senderGroup, senderButtons, TEST_BUTTONS, NULL);
+	buttons_InitGroup(&receiverGroup, receiverButtons, TEST_BUTTONS, NULL);
+	buttons_LinkInit(&sender, &senderGroup);
+	buttons_LinkInit(&receiver, &receiverGroup);
+
+	listener.stateMask = 0xFFFF;
+	listener.callback = test_Listener;
+	buttons_AddGroupListener(&receiverGroup, &listener);
+	numEvents = 0;
+}
+
+// Writes bytes to the master side, in chunks of the given size, and parses them as they arrive on the slave side
+static void test_Send(const uint8_t* data, uint16_t length, uint16_t chunk)
+{
+	for(uint16_t sent=0; sent<length; sent+=chunk)
+	{
+		uint16_t n = (uint16_t)(length - sent < chunk ? length - sent : chunk);
+		if(write(master, &data[sent], n) != n)
+		{
+			test_Fail("pty", "write failed");
+		}
+		uint16_t got = 0;
+		while(got < n)
+		{
+			struct pollfd fd = {slave, POLLIN, 0};
+			uint8_t buffer[256];
+			if(poll(&fd, 1, 1000) != 1)
+			{
+				test_Fail("pty", "timed out reading the slave side");
+			}
+			ssize_t r = read(slave, buffer, sizeof(buffer));
+			if(r <= 0)
+			{
+				test_Fail("pty", "read failed");
+			}
+			buttons_LinkParse(&receiver, buffer, (uint16_t)r);
+			got += (uint16_t)r;
+		}
+	}
+}
+
+// Sends every frame the sender has queued
+static uint16_t test_Flush(uint16_t chunk)
+{
+	uint8_t frame[BUTTONS_LINK_FRAME_SIZE];
+	uint16_t frames = 0;
+	uint16_t length;
+	while((length = buttons_LinkBuildFrame(&sender, frame)) != 0)
+	{
+		test_Send(frame, length, chunk);
+		frames++;
+	}
+	return frames;
+}
+
+static void test_Expect(const char* name, const TestEvent* expected, uint16_t numExpected)
+{
+	uint8_t ok = numEvents == numExpected;
+	for(uint16_t i=0; ok && i<numExpected; i++)
+	{
+		ok = events[i].button == expected[i].button && events[i].state == expected[i].state;
+	}
+	if(!ok)
+	{
+		printf("FAIL %s\n", name);
+		for(uint16_t i=0; i<numEvents; i++)
+		{
+			printf("  got button %u state %d\n", events[i].button, events[i].state);
+		}
+		exit(1);
+	}
+	printf("ok   %s\n", name);
+}
+
+static void test_Delivery(void)
+{
+	static const TestEvent expected[] = {
+		{ 0, Pressed }, { 2, Pressed }, { 0, Released }, { 2, Held }, { 2, HeldReleased },
+	};
+	test_Reset();
+	// Through the sender's state machine and poll, then queued directly
+	buttons_VirtualEdge(&senderButtons[0], ButtonEmulatePress, 1000);
+	buttons_VirtualEdge(&senderButtons[2], ButtonEmulatePress, 1000);
+	buttons_LinkPoll(&sender, &senderGroup);
+	buttons_VirtualEdge(&senderButtons[0], ButtonEmulateRelease, 1100);
+	buttons_LinkPoll(&sender, &senderGroup);
+	buttons_LinkQueueEvent(&sender, 2, Held);
+	buttons_LinkQueueEvent(&sender, 2, HeldReleased);
+	test_Flush(BUTTONS_LINK_FRAME_SIZE);
+	buttons_LinkDispatch(&receiver);
+	test_Expect("events arrive in order", expected, sizeof(expected) / sizeof(expected[0]));
+}
+
+static void test_SplitBytes(void)
+{
+	static const TestEvent expected[] = {
+		{ 1, Pressed }, { 1, Released }, { 3, DoublePressed },
+	};
+	test_Reset();
+	buttons_LinkQueueEvent(&sender, 1, Pressed);
+	buttons_LinkQueueEvent(&sender, 1, Released);
+	test_Flush(1);
+	buttons_LinkQueueEvent(&sender, 3, DoublePressed);
+	test_Flush(1);
+	buttons_LinkDispatch(&receiver);
+	test_Expect("frames split into single bytes", expected, sizeof(expected) / sizeof(expected[0]));
+}
+
+static void test_CrcRejection(void)
+{
+	static const TestEvent expected[] = {
+		{ 1, Released },
+	};
+	uint8_t frame[BUTTONS_LINK_FRAME_SIZE];
+	test_Reset();
+	buttons_LinkQueueEvent(&sender, 0, Pressed);
+	uint16_t length = buttons_LinkBuildFrame(&sender, frame);
+	frame[4] ^= 0x01;
+	test_Send(frame, length, length);
+	buttons_LinkQueueEvent(&sender, 1, Released);
+	test_Flush(BUTTONS_LINK_FRAME_SIZE);
+	buttons_LinkDispatch(&receiver);
+	if(receiver.rxCrcErrors != 1)
+	{
+		test_Fail("CRC rejection", "corrupted frame not counted");
+	}
+	test_Expect("corrupted frame rejected, next one delivered", expected, sizeof(expected) / sizeof(expected[0]));
+}
+
+static void test_Resync(void)
+{
+	// Noise with stray sync bytes, one of them followed by a plausible count
+	static const uint8_t garbage[] = {
+		0x00, 0xFF, BUTTONS_LINK_SYNC, 0x13, BUTTONS_LINK_SYNC, 0x05, 0x02, 0x00, 0x01, 0x7E,
+	};
+	static const TestEvent expected[] = {
+		{ 3, Pressed }, { 3, Released },
+	};
+	uint8_t stream[sizeof(garbage) + BUTTONS_LINK_FRAME_SIZE];
+	test_Reset();
+	memcpy(stream, garbage, sizeof(garbage));
+	buttons_LinkQueueEvent(&sender, 3, Pressed);
+	buttons_LinkQueueEvent(&sender, 3, Released);
+	uint16_t length = buttons_LinkBuildFrame(&sender, &stream[sizeof(garbage)]);
+	test_Send(stream, (uint16_t)(sizeof(garbage) + length), 3);
+	buttons_LinkDispatch(&receiver);
+	test_Expect("resync after garbage", expected, sizeof(expected) / sizeof(expected[0]));
+}
+
+static void test_LostFrames(void)
+{
+	uint8_t frame[BUTTONS_LINK_FRAME_SIZE];
+	test_Reset();
+	buttons_LinkQueueEvent(&sender, 0, Pressed);
+	test_Flush(BUTTONS_LINK_FRAME_SIZE);
+	buttons_LinkQueueEvent(&sender, 0, Released);
+	buttons_LinkBuildFrame(&sender, frame);
+	buttons_LinkQueueEvent(&sender, 1, Pressed);
+	test_Flush(BUTTONS_LINK_FRAME_SIZE);
+	if(receiver.rxLost != 1)
+	{
+		test_Fail("lost frames", "the skipped frame wasn't counted");
+	}
+	printf("ok   skipped frame counted as lost\n");
+}
+
+static void test_Overflow(void)
+{
+	// More events than the receive queue holds, with no dispatch in between
+	TestEvent expected[BUTTONS_LINK_QUEUE_SIZE];
+	uint32_t sent = BUTTONS_LINK_QUEUE_SIZE + 8;
+	uint32_t fit = BUTTONS_LINK_QUEUE_SIZE - 1;
+	test_Reset();
+	for(uint32_t i=0; i<sent; i++)
+	{
+		// Alternate states, so each event is applied after the previous one is dispatched
+		ButtonState state = (i & 1) ? Released : Pressed;
+		buttons_LinkQueueEvent(&sender, i % TEST_BUTTONS, state);
+		if(i < fit)
+		{
+			expected[i].button = (uint8_t)(i % TEST_BUTTONS);
+			expected[i].state = state;
+		}
+		if((i + 1) % (BUTTONS_LINK_QUEUE_SIZE / 2) == 0)
+		{
+			test_Flush(BUTTONS_LINK_FRAME_SIZE);
+		}
+	}
+	test_Flush(BUTTONS_LINK_FRAME_SIZE);
+	if(receiver.rxDropped != sent - fit)
+	{
+		printf("  rxDropped %u, expected %u\n", receiver.rxDropped, sent - fit);
+		test_Fail("receive overflow", "wrong drop count");
+	}
+	buttons_LinkDispatch(&receiver);
+	test_Expect("receive queue overflow drops the newest events", expected, (uint16_t)fit);
+}
+
+int main(void)
+{
+	struct termios raw;
+	if(openpty(&master, &slave, NULL, NULL, NULL) != 0)
+	{
+		test_Fail("pty", "openpty failed");
+	}
+	// A UART passes bytes untouched, so no line discipline on the receiving side
+	tcgetattr(slave, &raw);
+	cfmakeraw(&raw);
+	tcsetattr(slave, TCSANOW, &raw);
+
+	test_Delivery();
+	test_SplitBytes();
+	test_CrcRejection();
+	test_Resync();
+	test_LostFrames();
+	test_Overflow();
+
+	close(master);
+	close(slave);
+	return 0;
+}
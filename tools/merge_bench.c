@@ -0,0 +1,83 @@
+/*
+ * merge_bench.c
+ *
+ * Throughput of buttons_MergerPop() with 4 to 16 sources.
+ *
+ * Every source queue is kept topped up with events at increasing, interleaved
+ * timestamps, and the merger drains them in time order. Reports merged events
+ * per second (including refilling the queues) for each source count, and checks
+ * the merged stream is in time order. See README.md for building.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "buttons_merge.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_EVENTS	10000000UL
+#define BENCH_WINDOW	5
+
+static double bench_Seconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static double bench_Run(uint8_t numSources)
+{
+	ButtonEventQueue queues[16];
+	ButtonEventQueue* sources[16];
+	uint32_t sourceTime[16];
+	ButtonMerger merger;
+	ButtonEvent event;
+	uint32_t lastTime = 0;
+	unsigned long merged = 0;
+
+	for(uint8_t i=0; i<numSources; i++)
+	{
+		buttons_QueueInit(&queues[i]);
+		sources[i] = &queues[i];
+		sourceTime[i] = i;
+	}
+	buttons_MergerInit(&merger, sources, numSources, BENCH_WINDOW);
+	srand(1);
+
+	double start = bench_Seconds();
+	uint32_t now = 0;
+	while(merged < BENCH_EVENTS)
+	{
+		// Each source produces at its own irregular pace
+		for(uint8_t i=0; i<numSources; i++)
+		{
+			while((int32_t)(sourceTime[i] - (now + BENCH_WINDOW)) < 0 &&
+					buttons_QueuePush(&queues[i], i, Pressed, sourceTime[i]))
+			{
+				sourceTime[i] += 1 + (rand() & 7);
+			}
+		}
+		while(buttons_MergerPop(&merger, now, &event))
+		{
+			if((int32_t)(event.timestamp - lastTime) < 0)
+			{
+				printf("out of order: %u after %u\n", event.timestamp, lastTime);
+				exit(1);
+			}
+			lastTime = event.timestamp;
+			merged++;
+		}
+		now++;
+	}
+	return merged / (bench_Seconds() - start);
+}
+
+int main(void)
+{
+	for(uint8_t sources=4; sources<=16; sources*=2)
+	{
+		printf("%2u sources: %6.1f M events/s\n", sources, bench_Run(sources) / 1e6);
+	}
+	return 0;
+}
@@ -0,0 +1,225 @@
+/*
+ * midi_test.c
+ *
+ * Drives ButtonMidi on a host with a byte sink standing in for the UART. The sink
+ * keeps each transfer pending like DMA would, and only copies the ring bytes out
+ * when the transfer completes, so bytes overwritten while in flight show up.
+ * Checks running status elision on the DIN output, ring wrap with a transfer in
+ * flight, and USB-MIDI packet expansion. Exits non-zero on the first failure.
+ * See README.md for building.
+ */
+
+#include "buttons_midi.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_MAX_BYTES	1024
+
+static ButtonMidi midi;
+static uint8_t output[TEST_MAX_BYTES];
+static uint16_t outputLength;
+static const uint8_t* pendingData;
+static uint16_t pendingLength;
+static uint8_t synchronous;
+
+//-------------- BYTE SINK --------------//
+static uint8_t test_Transmit(const uint8_t* data, uint16_t length)
+{
+	pendingData = data;
+	pendingLength = length;
+	if(synchronous)
+	{
+		memcpy(&output[outputLength], data, length);
+		outputLength += length;
+		pendingLength = 0;
+		buttons_MidiTxComplete(&midi);
+	}
+	return 1;
+}
+
+// Ends the transfer in flight, as the UART TX complete interrupt would
+static void test_Complete(void)
+{
+	if(pendingLength == 0)
+	{
+		return;
+	}
+	memcpy(&output[outputLength], pendingData, pendingLength);
+	outputLength += pendingLength;
+	pendingLength = 0;
+	buttons_MidiTxComplete(&midi);
+}
+
+//-------------- TESTS --------------//
+static void test_Reset(uint8_t useRunningStatus, uint8_t usb, uint8_t isSynchronous)
+{
+	memset(&midi, 0, sizeof(midi));
+	buttons_MidiInit(&midi);
+	midi.transmit = test_Transmit;
+	midi.useRunningStatus = useRunningStatus;
+	midi.usb = usb;
+	outputLength = 0;
+	pendingLength = 0;
+	synchronous = isSynchronous;
+}
+
+static void test_Expect(const char* name, const uint8_t* got, uint16_t gotLength, const uint8_t* expected, uint16_t length)
+{
+	if(gotLength != length || memcmp(got, expected, length) != 0)
+	{
+		printf("FAIL %s\n  got     ", name);
+		for(uint16_t i=0; i<gotLength; i++)
+		{
+			printf(" %02X", got[i]);
+		}
+		printf("\n  expected");
+		for(uint16_t i=0; i<length; i++)
+		{
+			printf(" %02X", expected[i]);
+		}
+		printf("\n");
+		exit(1);
+	}
+	printf("ok   %s\n", name);
+}
+
+static void test_RunningStatus(void)
+{
+	static const ButtonMidiBinding bindings[] = {
+		{ 0, Pressed, 0x90, 60, 127 },
+		{ 0, Released, 0x90, 60, 0 },
+		{ 1, Pressed, 0xB0, 7, 100 },
+		{ 1, Pressed, 0xC0, 5, 0 },
+		{ 2, Pressed, 0x90, 62, 127 },
+	};
+	static const ButtonMidiBindingSet set = { bindings, sizeof(bindings) / sizeof(bindings[0]) };
+	static const uint8_t expected[] = {
+		0x90, 60, 127, 60, 0,		// repeated note on status omitted
+		0xB0, 7, 100, 0xC0, 5,
+		0x90, 62, 127,				// status sent again after other messages
+	};
+	static const uint8_t plain[] = {
+		0x90, 60, 127, 0x90, 60, 0,
+	};
+	test_Reset(1, 0, 1);
+	buttons_MidiPublishBindings(&midi, &set);
+	buttons_MidiEvent(&midi, 0, Pressed);
+	buttons_MidiEvent(&midi, 0, Released);
+	buttons_MidiDrain(&midi);
+	buttons_MidiEvent(&midi, 1, Pressed);
+	buttons_MidiEvent(&midi, 2, Pressed);
+	buttons_MidiDrain(&midi);
+	test_Expect("running status elision", output, outputLength, expected, sizeof(expected));
+
+	test_Reset(0, 0, 1);
+	buttons_MidiPublishBindings(&midi, &set);
+	buttons_MidiEvent(&midi, 0, Pressed);
+	buttons_MidiEvent(&midi, 0, Released);
+	buttons_MidiDrain(&midi);
+	test_Expect("full status without running status", output, outputLength, plain, sizeof(plain));
+}
+
+static void test_RingWrap(void)
+{
+	uint8_t expected[TEST_MAX_BYTES];
+	uint16_t expectedLength = 0;
+	test_Reset(0, 0, 0);
+
+	// Move the ring close to its end, then queue messages across it and start sending
+	uint16_t messages = (BUTTONS_MIDI_RING_SIZE - 8) / 3;
+	for(uint16_t i=0; i<messages + 5; i++)
+	{
+		uint8_t status = (i & 1) ? 0x80 : 0x90;
+		buttons_MidiSend(&midi, status, (uint8_t)i, 100);
+		expected[expectedLength++] = status;
+		expected[expectedLength++] = (uint8_t)i;
+		expected[expectedLength++] = 100;
+		if(i + 1 == messages)
+		{
+			buttons_MidiDrain(&midi);
+			test_Complete();
+		}
+	}
+	buttons_MidiDrain(&midi);
+	if(pendingLength != BUTTONS_MIDI_RING_SIZE - 3 * messages)
+	{
+		printf("FAIL ring wrap: %u bytes in flight, expected up to the end of the ring\n", pendingLength);
+		exit(1);
+	}
+
+	// While that is in flight, queue until the ring refuses, wrapping over its end.
+	// Nothing may land on the bytes being sent
+	uint16_t queued = 0;
+	for(uint16_t i=0; i<BUTTONS_MIDI_RING_SIZE; i++)
+	{
+		uint8_t status = (i & 1) ? 0xE1 : 0x91;
+		if(!buttons_MidiSend(&midi, status, (uint8_t)(i + 1), (uint8_t)(i + 2)))
+		{
+			break;
+		}
+		expected[expectedLength++] = status;
+		expected[expectedLength++] = (uint8_t)(i + 1);
+		expected[expectedLength++] = (uint8_t)(i + 2);
+		queued++;
+	}
+	if(queued == 0 || midi.dropped != 1)
+	{
+		printf("FAIL ring wrap: %u queued in flight, %u dropped\n", queued, midi.dropped);
+		exit(1);
+	}
+
+	// Each completion chains the next transfer: up to the end of the ring, then the wrapped part
+	for(uint8_t i=0; i<4; i++)
+	{
+		test_Complete();
+	}
+	test_Expect("ring wrap with a transfer in flight", output, outputLength, expected, expectedLength);
+	if(midi.head != midi.tail || midi.txBusy)
+	{
+		printf("FAIL ring wrap: ring not empty after the last transfer\n");
+		exit(1);
+	}
+}
+
+static void test_UsbPackets(void)
+{
+	static const uint8_t expected[] = {
+		0x29, 0x90, 60, 127,
+		0x29, 0x90, 62, 127,		// full status again, running status doesn't apply
+		0x2C, 0xC0, 5, 0,
+		0x2B, 0xB0, 7, 100,
+		0x2E, 0xE0, 0, 64,
+	};
+	uint8_t packets[sizeof(expected)];
+	uint16_t length = 0;
+	test_Reset(1, 1, 0);
+	midi.cable = 2;
+	buttons_MidiSend(&midi, 0x90, 60, 127);
+	buttons_MidiSend(&midi, 0x90, 62, 127);
+	buttons_MidiSend(&midi, 0xC0, 5, 99);
+	buttons_MidiSend(&midi, 0xB0, 7, 100);
+	buttons_MidiSend(&midi, 0xE0, 0, 64);
+	if(midi.runningStatus != 0)
+	{
+		printf("FAIL USB sends changed the DIN running status\n");
+		exit(1);
+	}
+	// Fewer packets per transfer than are queued, so the rest waits for the next one
+	length += buttons_MidiBuildUsbPackets(&midi, &packets[length], 3);
+	length += buttons_MidiBuildUsbPackets(&midi, &packets[length], 3);
+	test_Expect("USB-MIDI packet expansion", packets, length, expected, sizeof(expected));
+	if(buttons_MidiBuildUsbPackets(&midi, packets, 3) != 0)
+	{
+		printf("FAIL USB-MIDI packets left after the last message\n");
+		exit(1);
+	}
+}
+
+int main(void)
+{
+	test_RunningStatus();
+	test_RingWrap();
+	test_UsbPackets();
+	return 0;
+}
@@ -0,0 +1,281 @@
+/*
+ * path_explorer.c
+ *
+ * Worst case path through buttons_ExtiGpioCallback().
+ *
+ * buttons.c is built with -fsanitize-coverage=trace-pc,trace-cmp, so every basic
+ * block and comparison it executes calls back into this file. Each input of the
+ * edge state machine (lastState, timerTriggered, pressEvent, debounce bypass, edge,
+ * time since the last edge, hold timer configured or not) is run from a fresh
+ * button, and the blocks and comparisons of the call are counted. Paths are told
+ * apart by a hash of the blocks they visit. Reports every distinct path with its
+ * cost and first input, most expensive first, and the worst input, which can be
+ * replayed with emulated actions. The time since the last edge is enumerated at
+ * and around every timing boundary of the default profile, or drawn at random
+ * with "fuzz <count> [seed]". See README.md for building.
+ */
+
+#include "buttons.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EXPLORER_PIN		2
+#define EXPLORER_MAX_PATHS	256
+#define EXPLORER_MAX_TIMES	32
+#define EXPLORER_HOLD_TIME	1000
+
+typedef struct
+{
+	ButtonState lastState;
+	uint8_t timerTriggered;
+	uint8_t pressEvent;
+	uint8_t debounceBypass;
+	uint8_t edge;				// 0 = press, 1 = release
+	uint32_t lastTime;
+	uint32_t sinceLastEdge;
+	uint8_t timerConfigured;
+} ExplorerInput;
+
+typedef struct
+{
+	uint64_t hash;
+	uint32_t blocks;
+	uint32_t compares;
+	uint32_t hits;
+	ExplorerInput input;
+} ExplorerPath;
+
+static const char* const stateNames[] = {
+	"Pressed", "DoublePressed", "Released", "DoublePressReleased", "Held",
+	"HeldReleased", "Cleared", "HeldRepeat", "HoldProgress", "PressureChanged"
+};
+
+static uint8_t counting;
+static uint32_t blocks;
+static uint32_t compares;
+static uint64_t pathHash;
+static ExplorerPath paths[EXPLORER_MAX_PATHS];
+static uint16_t numPaths;
+static uint32_t numInputs;
+
+//-------------- COVERAGE CALLBACKS --------------//
+// Called by the instrumented buttons.c only
+void __sanitizer_cov_trace_pc(void)
+{
+	if(counting)
+	{
+		blocks++;
+		pathHash = (pathHash ^ (uint64_t)(uintptr_t)__builtin_return_address(0)) * 0x100000001B3ULL;
+	}
+}
+
+#define EXPLORER_CMP(name, type) \
+	void name(type a, type b) { (void)a; (void)b; if(counting) compares++; }
+EXPLORER_CMP(__sanitizer_cov_trace_cmp1, uint8_t)
+EXPLORER_CMP(__sanitizer_cov_trace_cmp2, uint16_t)
+EXPLORER_CMP(__sanitizer_cov_trace_cmp4, uint32_t)
+EXPLORER_CMP(__sanitizer_cov_trace_cmp8, uint64_t)
+EXPLORER_CMP(__sanitizer_cov_trace_const_cmp1, uint8_t)
+EXPLORER_CMP(__sanitizer_cov_trace_const_cmp2, uint16_t)
+EXPLORER_CMP(__sanitizer_cov_trace_const_cmp4, uint32_t)
+EXPLORER_CMP(__sanitizer_cov_trace_const_cmp8, uint64_t)
+
+void __sanitizer_cov_trace_switch(uint64_t value, uint64_t* cases)
+{
+	(void)value;
+	if(counting)
+	{
+		compares += (uint32_t)cases[0];
+	}
+}
+
+//-------------- HOLD TIMER --------------//
+static void explorer_TimerStart(void)
+{
+}
+
+static void explorer_TimerStop(void)
+{
+}
+
+static uint32_t explorer_TimerCount(void)
+{
+	return 0;
+}
+
+//-------------- EXPLORER --------------//
+static void explorer_Run(const ExplorerInput* input)
+{
+	static uint8_t timerConfigured;
+	if(input->timerConfigured && !timerConfigured)
+	{
+		// Once assigned the callbacks can't be unassigned, so configured inputs come last
+		buttons_AssignTimerStartCallback(explorer_TimerStart);
+		buttons_AssignTimerStopCallback(explorer_TimerStop);
+		buttons_AssignTimerGetCounterCallback(explorer_TimerCount);
+		timerConfigured = 1;
+	}
+
+	Button button;
+	memset(&button, 0, sizeof(button));
+	buttons_Init(&button);
+	button.logicMode = ActiveLow;
+	button.pin = EXPLORER_PIN;
+	button.lastState = input->lastState;
+	button.timerTriggered = input->timerTriggered;
+	button.pressEvent = input->pressEvent;
+	button.debounceBypass = input->debounceBypass;
+	button.lastTime = input->lastTime;
+
+	host_SetMillis(input->lastTime + input->sinceLastEdge);
+	host_SetPin(EXPLORER_PIN, input->edge ? HIGH : LOW);
+
+	blocks = 0;
+	compares = 0;
+	pathHash = 0xCBF29CE484222325ULL;
+	counting = 1;
+	buttons_ExtiGpioCallback(&button, ButtonEmulateNone);
+	counting = 0;
+	numInputs++;
+
+	for(uint16_t i=0; i<numPaths; i++)
+	{
+		if(paths[i].hash == pathHash)
+		{
+			paths[i].hits++;
+			return;
+		}
+	}
+	if(numPaths == EXPLORER_MAX_PATHS)
+	{
+		return;
+	}
+	paths[numPaths].hash = pathHash;
+	paths[numPaths].blocks = blocks;
+	paths[numPaths].compares = compares;
+	paths[numPaths].hits = 1;
+	paths[numPaths].input = *input;
+	numPaths++;
+}
+
+// Every timing boundary of the default profile, with its neighbours
+static uint16_t explorer_Times(uint32_t* times)
+{
+	const ButtonTimingProfile* timing = &buttons_GetConfig()->profiles[0];
+	const uint32_t boundaries[] = {
+		0, timing->debounceLowToHigh, timing->debounceHighToLow, timing->doublePressTime,
+		MULTIPLE_BUTTON_TIME, timing->holdTime != 0 ? timing->holdTime : EXPLORER_HOLD_TIME
+	};
+	uint16_t n = 0;
+	for(uint8_t i=0; i<sizeof(boundaries) / sizeof(boundaries[0]); i++)
+	{
+		for(int32_t delta=-1; delta<=1; delta++)
+		{
+			if(boundaries[i] + delta <= 0xFFFF && n < EXPLORER_MAX_TIMES)
+			{
+				times[n++] = boundaries[i] + delta;
+			}
+		}
+	}
+	times[n++] = 60000;
+	return n;
+}
+
+static void explorer_Enumerate(void)
+{
+	uint32_t times[EXPLORER_MAX_TIMES + 1];
+	uint16_t numTimes = explorer_Times(times);
+	const uint32_t lastTimes[] = { 0, 10000 };
+	ExplorerInput input;
+
+	for(uint8_t configured=0; configured<=1; configured++)
+	for(uint8_t state=0; state<=PressureChanged; state++)
+	for(uint8_t flags=0; flags<8; flags++)
+	for(uint8_t edge=0; edge<=1; edge++)
+	for(uint8_t last=0; last<2; last++)
+	for(uint16_t t=0; t<numTimes; t++)
+	{
+		input.lastState = (ButtonState)state;
+		input.timerTriggered = flags & 1;
+		input.pressEvent = (flags >> 1) & 1;
+		input.debounceBypass = (flags >> 2) & 1;
+		input.edge = edge;
+		input.lastTime = lastTimes[last];
+		input.sinceLastEdge = times[t];
+		input.timerConfigured = configured;
+		explorer_Run(&input);
+	}
+}
+
+static void explorer_Fuzz(uint32_t count, uint32_t seed)
+{
+	ExplorerInput input;
+	srand(seed);
+	for(uint8_t configured=0; configured<=1; configured++)
+	{
+		for(uint32_t i=0; i<count / 2; i++)
+		{
+			input.lastState = (ButtonState)(rand() % (PressureChanged + 1));
+			input.timerTriggered = rand() & 1;
+			input.pressEvent = rand() & 1;
+			input.debounceBypass = rand() & 1;
+			input.edge = rand() & 1;
+			input.lastTime = (rand() & 1) ? (uint32_t)rand() : 0;
+			input.sinceLastEdge = (uint32_t)(rand() % 2000);
+			input.timerConfigured = configured;
+			explorer_Run(&input);
+		}
+	}
+}
+
+static int explorer_CompareCost(const void* a, const void* b)
+{
+	const ExplorerPath* pa = (const ExplorerPath*)a;
+	const ExplorerPath* pb = (const ExplorerPath*)b;
+	if(pa->blocks != pb->blocks)
+	{
+		return pa->blocks < pb->blocks ? 1 : -1;
+	}
+	return pa->compares < pb->compares ? 1 : (pa->compares > pb->compares ? -1 : 0);
+}
+
+static void explorer_PrintInput(const ExplorerInput* input)
+{
+	printf("lastState=%s timerTriggered=%u pressEvent=%u debounceBypass=%u edge=%s "
+			"lastTime=%u sinceLastEdge=%u timer=%s",
+			stateNames[input->lastState], input->timerTriggered, input->pressEvent,
+			input->debounceBypass, input->edge ? "release" : "press", input->lastTime,
+			input->sinceLastEdge, input->timerConfigured ? "configured" : "none");
+}
+
+int main(int argc, char** argv)
+{
+	buttons_SetHoldTime(EXPLORER_HOLD_TIME);
+	if(argc >= 3 && strcmp(argv[1], "fuzz") == 0)
+	{
+		explorer_Fuzz((uint32_t)strtoul(argv[2], NULL, 0), argc >= 4 ? (uint32_t)strtoul(argv[3], NULL, 0) : 1);
+	}
+	else
+	{
+		explorer_Enumerate();
+	}
+
+	qsort(paths, numPaths, sizeof(paths[0]), explorer_CompareCost);
+	printf("%u inputs, %u distinct paths%s\n", numInputs, numPaths,
+			numPaths == EXPLORER_MAX_PATHS ? " (table full, later paths not kept)" : "");
+	printf("blocks  compares  inputs  first input\n");
+	for(uint16_t i=0; i<numPaths; i++)
+	{
+		printf("%6u  %8u  %6u  ", paths[i].blocks, paths[i].compares, paths[i].hits);
+		explorer_PrintInput(&paths[i].input);
+		printf("\n");
+	}
+	if(numPaths > 0)
+	{
+		printf("worst: %u blocks, %u compares for ", paths[0].blocks, paths[0].compares);
+		explorer_PrintInput(&paths[0].input);
+		printf("\n");
+	}
+	return 0;
+}
@@ -0,0 +1,87 @@
+#!/bin/sh
+# Compares the buttons_budget.h estimates with the RAM the library's globals really
+# take: the .data and .bss objects of buttons.c (and buttons_trace.c with BUTTONS_TRACE)
+# built with $CC and $CFLAGS, or, given a GNU ld map file of the firmware, the input
+# sections the linker placed from buttons.o and buttons_trace.o (built with
+# -fdata-sections). Exits non-zero when the estimate is below the real size.
+# See tools/README.md.
+#
+# Usage: CC=... CFLAGS="..." tools/ram_check.sh [firmware.map]
+set -e
+cd "$(dirname "$0")/.."
+
+CC=${CC:-gcc}
+NM=${NM:-nm}
+OBJDUMP=${OBJDUMP:-objdump}
+CFLAGS=${CFLAGS:--DFRAMEWORK_ARDUINO=1 -Itools/host}
+OUT=${OUT:-build/ram_check}
+MAP=$1
+
+mkdir -p "$OUT"
+
+# The estimates, as the sizes of arrays so they can be read without running the target
+cat > "$OUT/probe.c" <<'EOF'
+#include "buttons_budget.h"
+char ramCore[BUTTONS_CORE_RAM];
+#if BUTTONS_TRACE
+char ramTrace[BUTTONS_TRACE_RAM - sizeof(ButtonTraceSink)];
+#endif
+EOF
+$CC $CFLAGS -Iinclude -c "$OUT/probe.c" -o "$OUT/probe.o"
+
+# Portable awk has no hex conversion
+HEX='function hex(s,  i, n) { sub(/^0x/, "", s); n = 0; for(i = 1; i <= length(s); i++) n = n * 16 + index("0123456789abcdef", tolower(substr(s, i, 1))) - 1; return n }'
+
+# Size of a symbol of the probe, 0 when it isn't there
+estimate()
+{
+	$NM -S "$OUT/probe.o" | awk -v name="$1" "$HEX"'$4 == name { print hex($2); found = 1 } END { if(!found) print 0 }'
+}
+
+# Bytes of the .data and .bss objects of an object file. Constant tables holding pointers
+# go to .data.rel.ro in position independent host builds, they are flash on the target
+measured_object()
+{
+	$CC $CFLAGS -Iinclude -fdata-sections -c "src/$1.c" -o "$OUT/$1.o"
+	$OBJDUMP -t "$OUT/$1.o" | awk "$HEX"'
+		NF >= 4 && $(NF - 2) ~ /^\.(s?bss|s?data)(\.|$)/ && $(NF - 2) !~ /^\.data\.rel\.ro/ { total += hex($(NF - 1)) }
+		END { print total + 0 }'
+}
+
+# Bytes of the .data and .bss input sections the map lists for an object. Long section
+# names put the address and size on the following line
+measured_map()
+{
+	awk -v object="(^|[/(])$1\\.o\\)?$" "$HEX"'
+		/^ \.data\.rel\.ro/ { pending = 0; next }
+		/^ \.(s?bss|s?data)(\.|[ \t]|$)/ { pending = ($2 == "") }
+		/^ \.(s?bss|s?data)(\.|[ \t]|$)/ && NF >= 4 && $4 ~ object { total += hex($3) }
+		pending && /^[ \t]+0x/ && NF >= 3 && $3 ~ object { total += hex($2); pending = 0 }
+		END { print total + 0 }' "$MAP"
+}
+
+status=0
+check()
+{
+	if [ -n "$MAP" ]; then
+		real=$(measured_map "$1")
+	else
+		real=$(measured_object "$1")
+	fi
+	est=$(estimate "$2")
+	if [ "$est" -lt "$real" ]; then
+		verdict="UNDER by $((real - est))"
+		status=1
+	elif [ "$est" -gt "$real" ]; then
+		verdict="over by $((est - real))"
+	else
+		verdict="equal"
+	fi
+	printf "%-14s estimate %5u  real %5u  %s\n" "$1" "$est" "$real" "$verdict"
+}
+
+check buttons ramCore
+if [ "$(estimate ramTrace)" -ne 0 ]; then
+	check buttons_trace ramTrace
+fi
+exit $status
@@ -0,0 +1,122 @@
+/*
+ * buttons_scan_simd.c
+ *
+ * Vectorised bit-parallel debounce. See buttons_scan_simd.h.
+ */
+
+#include "buttons_scan_simd.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//-------------- PRIVATE FUNCTION PROTOTYPES --------------//
+void buttons_ScanSimdWord(ButtonScanBank* bank, size_t i, uint32_t sample, uint32_t* pressed, uint32_t* released);
+
+
+//-------------- PUBLIC FUNCTIONS --------------//
+void buttons_ScanSimdInit(ButtonScanBank* bank)
+{
+	// Counters idle at 3, as in buttons_ScanInit()
+	for(size_t i=0; i<bank->numWords; i++)
+	{
+		bank->counter0[i] = 0xFFFFFFFFUL;
+		bank->counter1[i] = 0xFFFFFFFFUL;
+		bank->state[i] = 0;
+	}
+}
+
+void buttons_ScanSimdProcess(ButtonScanBank* bank, const uint32_t* samples, uint32_t* pressed, uint32_t* released)
+{
+	size_t i = 0;
+
+#if defined(__AVX2__)
+	size_t vectorWords = bank->numWords - bank->numWords % BUTTONS_SCAN_SIMD_WORDS;
+	const __m256i ones = _mm256_set1_epi32(-1);
+	for(; i<vectorWords; i+=BUTTONS_SCAN_SIMD_WORDS)
+	{
+		__m256i sample = _mm256_loadu_si256((const __m256i*)&samples[i]);
+		__m256i activeLow = _mm256_loadu_si256((const __m256i*)&bank->activeLowMask[i]);
+		__m256i lanes = _mm256_loadu_si256((const __m256i*)&bank->laneMask[i]);
+		__m256i counter0 = _mm256_loadu_si256((const __m256i*)&bank->counter0[i]);
+		__m256i counter1 = _mm256_loadu_si256((const __m256i*)&bank->counter1[i]);
+		__m256i state = _mm256_loadu_si256((const __m256i*)&bank->state[i]);
+
+		__m256i changed = _mm256_xor_si256(_mm256_and_si256(_mm256_xor_si256(sample, activeLow), lanes), state);
+		counter0 = _mm256_xor_si256(_mm256_and_si256(counter0, changed), ones);
+		counter1 = _mm256_xor_si256(counter0, _mm256_and_si256(counter1, changed));
+		changed = _mm256_and_si256(changed, _mm256_and_si256(counter0, counter1));
+		state = _mm256_xor_si256(state, changed);
+
+		_mm256_storeu_si256((__m256i*)&bank->counter0[i], counter0);
+		_mm256_storeu_si256((__m256i*)&bank->counter1[i], counter1);
+		_mm256_storeu_si256((__m256i*)&bank->state[i], state);
+		_mm256_storeu_si256((__m256i*)&pressed[i], _mm256_and_si256(changed, state));
+		_mm256_storeu_si256((__m256i*)&released[i], _mm256_andnot_si256(state, changed));
+	}
+#elif defined(__ARM_NEON)
+	// Two 128 bit registers per 256 lanes
+	size_t vectorWords = bank->numWords - bank->numWords % BUTTONS_SCAN_SIMD_WORDS;
+	for(; i<vectorWords; i+=4)
+	{
+		uint32x4_t sample = vld1q_u32(&samples[i]);
+		uint32x4_t activeLow = vld1q_u32(&bank->activeLowMask[i]);
+		uint32x4_t lanes = vld1q_u32(&bank->laneMask[i]);
+		uint32x4_t counter0 = vld1q_u32(&bank->counter0[i]);
+		uint32x4_t counter1 = vld1q_u32(&bank->counter1[i]);
+		uint32x4_t state = vld1q_u32(&bank->state[i]);
+
+		uint32x4_t changed = veorq_u32(vandq_u32(veorq_u32(sample, activeLow), lanes), state);
+		counter0 = vmvnq_u32(vandq_u32(counter0, changed));
+		counter1 = veorq_u32(counter0, vandq_u32(counter1, changed));
+		changed = vandq_u32(changed, vandq_u32(counter0, counter1));
+		state = veorq_u32(state, changed);
+
+		vst1q_u32(&bank->counter0[i], counter0);
+		vst1q_u32(&bank->counter1[i], counter1);
+		vst1q_u32(&bank->state[i], state);
+		vst1q_u32(&pressed[i], vandq_u32(changed, state));
+		vst1q_u32(&released[i], vbicq_u32(changed, state));
+	}
+#endif
+
+	for(; i<bank->numWords; i++)
+	{
+		buttons_ScanSimdWord(bank, i, samples[i], &pressed[i], &released[i]);
+	}
+}
+
+const char* buttons_ScanSimdKernel(void)
+{
+#if defined(__AVX2__)
+	return "avx2";
+#elif defined(__ARM_NEON)
+	return "neon";
+#else
+	return "scalar";
+#endif
+}
+
+
+//-------------- PRIVATE FUNCTIONS --------------//
+void buttons_ScanSimdWord(ButtonScanBank* bank, size_t i, uint32_t sample, uint32_t* pressed, uint32_t* released)
+{
+	// The same operations as buttons_ScanProcess()
+	uint32_t changed = ((sample ^ bank->activeLowMask[i]) & bank->laneMask[i]) ^ bank->state[i];
+	bank->counter0[i] = ~(bank->counter0[i] & changed);
+	bank->counter1[i] = bank->counter0[i] ^ (bank->counter1[i] & changed);
+	changed &= bank->counter0[i] & bank->counter1[i];
+	bank->state[i] ^= changed;
+	*pressed = changed & bank->state[i];
+	*released = changed & ~bank->state[i];
+}
+
+#ifdef __cplusplus
+}
+#endif
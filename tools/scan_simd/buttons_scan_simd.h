@@ -0,0 +1,47 @@
+/*
+ * buttons_scan_simd.h
+ *
+ * Host only, vectorised form of the bit-parallel debounce in buttons_scan.h, for
+ * simulating very many buttons.
+ *
+ * A bank is an array of 32 bit sample words, one lane per button, with the same
+ * 2 bit vertical counter per lane as buttons_ScanProcess(). Each call takes one sample
+ * word per bank word and returns the press and release edges of every lane as bit
+ * masks, 256 lanes per AVX2 register on x86 (build with -mavx2) or per pair of NEON
+ * registers on ARM, with a scalar tail. The result is bit-exact with
+ * buttons_ScanProcess() on the same words (see scan_bench.c). Edges are not passed to
+ * Button structures, the masks are the output.
+ */
+#ifndef BUTTONS_SCAN_SIMD_H_
+#define BUTTONS_SCAN_SIMD_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Words of one 256 bit vector
+#define BUTTONS_SCAN_SIMD_WORDS	8
+
+typedef struct
+{
+	// Assign in application
+	size_t numWords;
+	const uint32_t* laneMask;		// numWords entries, bits to debounce
+	const uint32_t* activeLowMask;	// numWords entries, bits that read 0 when pressed
+	uint32_t* counter0;				// numWords entries each, storage for the state
+	uint32_t* counter1;
+	uint32_t* state;				// debounced, 1 = pressed
+} ButtonScanBank;
+
+void buttons_ScanSimdInit(ButtonScanBank* bank);
+void buttons_ScanSimdProcess(ButtonScanBank* bank, const uint32_t* samples, uint32_t* pressed, uint32_t* released);
+const char* buttons_ScanSimdKernel(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BUTTONS_SCAN_SIMD_H_ */
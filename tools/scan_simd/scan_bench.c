@@ -0,0 +1,172 @@
+/*
+ * scan_bench.c
+ *
+ * Checks buttons_ScanSimdProcess() is bit-exact with buttons_ScanProcess() on random
+ * bouncing sample streams (including a scalar tail), then reports button-samples per
+ * second on one core for both. See tools/README.md for building.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "buttons_scan.h"
+#include "buttons_scan_simd.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_CHECK_WORDS	1003
+#define BENCH_CHECK_SAMPLES	2000
+#define BENCH_WORDS			32768		// 1M buttons
+#define BENCH_STREAM		16
+#define BENCH_SAMPLES		2000
+
+static double bench_Seconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static uint32_t bench_Random(void)
+{
+	return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+static uint32_t* bench_Alloc(size_t words)
+{
+	uint32_t* p = (uint32_t*)calloc(words, sizeof(uint32_t));
+	if(p == NULL)
+	{
+		printf("out of memory\n");
+		exit(1);
+	}
+	return p;
+}
+
+static void bench_Bank(ButtonScanBank* bank, size_t words, uint32_t* laneMask, uint32_t* activeLowMask)
+{
+	bank->numWords = words;
+	bank->laneMask = laneMask;
+	bank->activeLowMask = activeLowMask;
+	bank->counter0 = bench_Alloc(words);
+	bank->counter1 = bench_Alloc(words);
+	bank->state = bench_Alloc(words);
+	buttons_ScanSimdInit(bank);
+}
+
+static void bench_Check(void)
+{
+	static Button* noButtons[BUTTONS_SCAN_LANES];
+	static ButtonScanPort ports[BENCH_CHECK_WORDS];
+	uint32_t* laneMask = bench_Alloc(BENCH_CHECK_WORDS);
+	uint32_t* activeLowMask = bench_Alloc(BENCH_CHECK_WORDS);
+	uint32_t* level = bench_Alloc(BENCH_CHECK_WORDS);
+	uint32_t* samples = bench_Alloc(BENCH_CHECK_WORDS);
+	uint32_t* pressed = bench_Alloc(BENCH_CHECK_WORDS);
+	uint32_t* released = bench_Alloc(BENCH_CHECK_WORDS);
+	ButtonScanBank bank;
+	unsigned long edges = 0;
+
+	srand(1);
+	for(size_t i=0; i<BENCH_CHECK_WORDS; i++)
+	{
+		laneMask[i] = bench_Random() | bench_Random();
+		activeLowMask[i] = bench_Random();
+		ports[i].buttons = noButtons;
+		ports[i].laneMask = laneMask[i];
+		ports[i].activeLowMask = activeLowMask[i];
+		buttons_ScanInit(&ports[i]);
+	}
+	bench_Bank(&bank, BENCH_CHECK_WORDS, laneMask, activeLowMask);
+
+	for(uint32_t t=0; t<BENCH_CHECK_SAMPLES; t++)
+	{
+		for(size_t i=0; i<BENCH_CHECK_WORDS; i++)
+		{
+			// Occasional level changes, with contact bounce on a quarter of the lanes
+			if((rand() & 15) == 0)
+			{
+				level[i] ^= bench_Random() & bench_Random();
+			}
+			samples[i] = level[i] ^ (bench_Random() & bench_Random() & bench_Random());
+		}
+		buttons_ScanSimdProcess(&bank, samples, pressed, released);
+		for(size_t i=0; i<BENCH_CHECK_WORDS; i++)
+		{
+			uint32_t changed = buttons_ScanProcess(&ports[i], samples[i], t);
+			uint32_t state = buttons_ScanGetState(&ports[i]);
+			if(bank.state[i] != state || (pressed[i] | released[i]) != changed ||
+					pressed[i] != (changed & state) || (pressed[i] & released[i]) != 0)
+			{
+				printf("mismatch at sample %u word %zu\n", t, i);
+				exit(1);
+			}
+			edges += (unsigned long)__builtin_popcount(changed);
+		}
+	}
+	printf("bit-exact with buttons_ScanProcess: %u samples x %u words, %lu edges\n",
+			BENCH_CHECK_SAMPLES, BENCH_CHECK_WORDS, edges);
+}
+
+static void bench_Throughput(void)
+{
+	static Button* noButtons[BUTTONS_SCAN_LANES];
+	uint32_t* laneMask = bench_Alloc(BENCH_WORDS);
+	uint32_t* activeLowMask = bench_Alloc(BENCH_WORDS);
+	uint32_t* pressed = bench_Alloc(BENCH_WORDS);
+	uint32_t* released = bench_Alloc(BENCH_WORDS);
+	uint32_t* stream[BENCH_STREAM];
+	ButtonScanPort* ports = (ButtonScanPort*)calloc(BENCH_WORDS, sizeof(ButtonScanPort));
+	ButtonScanBank bank;
+	uint32_t sink = 0;
+
+	for(size_t i=0; i<BENCH_WORDS; i++)
+	{
+		laneMask[i] = 0xFFFFFFFFUL;
+		ports[i].buttons = noButtons;
+		ports[i].laneMask = laneMask[i];
+		buttons_ScanInit(&ports[i]);
+	}
+	for(uint8_t s=0; s<BENCH_STREAM; s++)
+	{
+		stream[s] = bench_Alloc(BENCH_WORDS);
+		for(size_t i=0; i<BENCH_WORDS; i++)
+		{
+			stream[s][i] = bench_Random() & bench_Random() & bench_Random();
+		}
+	}
+	bench_Bank(&bank, BENCH_WORDS, laneMask, activeLowMask);
+
+	double start = bench_Seconds();
+	for(uint32_t t=0; t<BENCH_SAMPLES; t++)
+	{
+		buttons_ScanSimdProcess(&bank, stream[t % BENCH_STREAM], pressed, released);
+		sink ^= pressed[t % BENCH_WORDS];
+	}
+	double simd = (double)BENCH_WORDS * 32 * BENCH_SAMPLES / (bench_Seconds() - start);
+
+	start = bench_Seconds();
+	for(uint32_t t=0; t<BENCH_SAMPLES; t++)
+	{
+		const uint32_t* samples = stream[t % BENCH_STREAM];
+		for(size_t i=0; i<BENCH_WORDS; i++)
+		{
+			sink ^= buttons_ScanProcess(&ports[i], samples[i], t);
+		}
+	}
+	double scalar = (double)BENCH_WORDS * 32 * BENCH_SAMPLES / (bench_Seconds() - start);
+
+	printf("%s: %8.1f G button-samples/s per core\n", buttons_ScanSimdKernel(), simd / 1e9);
+	printf("buttons_ScanProcess: %8.1f G button-samples/s per core\n", scalar / 1e9);
+	if(sink == 0x12345678)
+	{
+		printf("\n");
+	}
+}
+
+int main(void)
+{
+	bench_Check();
+	bench_Throughput();
+	return 0;
+}
@@ -0,0 +1,168 @@
+/*
+ * trace_decode.c
+ *
+ * Prints a buttons_trace.h record stream, one line per record.
+ *
+ * Reads a capture file, or a serial port (any tty) set to raw 8N1 at the given baud
+ * rate, until the end of the file or the port is closed. The stream is resynchronised
+ * on the SYNC byte after corruption or when joining it midway, and the bytes skipped
+ * are reported.
+ *
+ * Usage: trace_decode [-b baud] <file|device>
+ * See README.md for building.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "buttons_trace.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+static const char* const typeNames[] = { "edge", "rejected", "event", "dropped" };
+
+static const char* const stateNames[] = {
+	"Pressed", "DoublePressed", "Released", "DoublePressReleased", "Held",
+	"HeldReleased", "Cleared", "HeldRepeat", "HoldProgress", "PressureChanged"
+};
+
+static const struct
+{
+	unsigned long baud;
+	speed_t speed;
+} speeds[] = {
+	{9600, B9600}, {19200, B19200}, {38400, B38400}, {57600, B57600}, {115200, B115200},
+	{230400, B230400}, {460800, B460800}, {921600, B921600}, {1000000, B1000000},
+	{2000000, B2000000}
+};
+
+static uint8_t decode_SetupSerial(int fd, unsigned long baud)
+{
+	struct termios tty;
+	speed_t speed = 0;
+	for(size_t i=0; i<sizeof(speeds) / sizeof(speeds[0]); i++)
+	{
+		if(speeds[i].baud == baud)
+		{
+			speed = speeds[i].speed;
+		}
+	}
+	if(speed == 0 || tcgetattr(fd, &tty) != 0)
+	{
+		return 0;
+	}
+	cfmakeraw(&tty);
+	cfsetispeed(&tty, speed);
+	cfsetospeed(&tty, speed);
+	tty.c_cflag |= CLOCAL | CREAD;
+	tty.c_cflag &= ~(CSTOPB | CRTSCTS);
+	tty.c_cc[VMIN] = 1;
+	tty.c_cc[VTIME] = 0;
+	return tcsetattr(fd, TCSANOW, &tty) == 0;
+}
+
+static void decode_Print(const uint8_t* r)
+{
+	uint32_t timestamp = r[4] | (r[5] << 8) | (r[6] << 16) | ((uint32_t)r[7] << 24);
+	if(r[1] == ButtonTraceDropped)
+	{
+		printf("%10s  %-8s total %u\n", "", typeNames[r[1]], timestamp);
+		return;
+	}
+	printf("%10u  %-8s ", timestamp, typeNames[r[1]]);
+	if(r[2] == 0xFF)
+	{
+		printf("  -  ");
+	}
+	else
+	{
+		printf("%3u  ", r[2]);
+	}
+	if(r[1] == ButtonTraceEvent)
+	{
+		printf("%s\n", r[3] <= PressureChanged ? stateNames[r[3]] : "?");
+	}
+	else
+	{
+		printf("%s\n", r[3] ? "press" : "release");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned long baud = 115200;
+	int opt;
+	while((opt = getopt(argc, argv, "b:")) != -1)
+	{
+		if(opt != 'b')
+		{
+			goto usage;
+		}
+		baud = strtoul(optarg, NULL, 0);
+	}
+	if(optind + 1 != argc)
+	{
+		goto usage;
+	}
+
+	int fd = open(argv[optind], O_RDONLY | O_NOCTTY);
+	if(fd < 0)
+	{
+		fprintf(stderr, "can't open %s\n", argv[optind]);
+		return 1;
+	}
+	if(isatty(fd) && !decode_SetupSerial(fd, baud))
+	{
+		fprintf(stderr, "can't set %s to %lu baud\n", argv[optind], baud);
+		return 1;
+	}
+
+	uint8_t buffer[4096];
+	size_t length = 0;
+	unsigned long skipped = 0;
+	for(;;)
+	{
+		ssize_t got = read(fd, &buffer[length], sizeof(buffer) - length);
+		if(got <= 0)
+		{
+			break;
+		}
+		length += (size_t)got;
+
+		size_t i = 0;
+		while(i + BUTTONS_TRACE_RECORD_SIZE <= length)
+		{
+			if(buffer[i] != BUTTONS_TRACE_SYNC || buffer[i + 1] > ButtonTraceDropped)
+			{
+				i++;
+				skipped++;
+				continue;
+			}
+			if(skipped != 0)
+			{
+				printf("(%lu bytes skipped)\n", skipped);
+				skipped = 0;
+			}
+			decode_Print(&buffer[i]);
+			i += BUTTONS_TRACE_RECORD_SIZE;
+		}
+		// Keep the start of a record split across reads
+		memmove(buffer, &buffer[i], length - i);
+		length -= i;
+		fflush(stdout);
+	}
+	skipped += length;
+	if(skipped != 0)
+	{
+		printf("(%lu bytes skipped)\n", skipped);
+	}
+	close(fd);
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: trace_decode [-b baud] <file|device>\n");
+	return 2;
+}
@@ -0,0 +1,479 @@
+/*
+ * tune_advisor.c
+ *
+ * Recommends debounce and double press timing from captured traces, see buttons_tune.h.
+ *
+ * Reads files in the buttons_trace.h record format (8 byte records, resynchronising on
+ * the SYNC byte after corruption). The accepted and rejected edges of each button form
+ * its raw edge trace, events are ignored. The real presses of a file are read from
+ * "<file>.presses" when it exists, one "button timestamp [duration] [d]" line per press
+ * (duration from the first contact of the press to that of its release, "d" for the second
+ * press of a double press), otherwise they are taken to be every press that stays down for
+ * the settle time, from its first contact to the first contact of its release.
+ *
+ * Every combination of the timing grid is evaluated for each profile (buttons map to
+ * profiles with -p, profile 0 otherwise), candidates spread over all cores, and the
+ * Pareto front of false events (presses and releases), missed presses and mean latency is
+ * printed with the recommended profile.
+ *
+ * Usage: tune_advisor [-l min:max:step] [-h min:max:step] [-d min:max:step] [-s settle]
+ *                     [-p button=profile]... [-j threads] trace...
+ * -l debounceLowToHigh, -h debounceHighToLow, -d doublePressTime, all in ms.
+ * See README.md for building.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "buttons_trace.h"
+#include "buttons_tune.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TUNE_MAX_BUTTONS	255
+#define TUNE_MAX_PROFILES	16
+#define TUNE_MAX_THREADS	256
+
+typedef struct
+{
+	uint32_t min;
+	uint32_t max;
+	uint32_t step;
+} TuneRange;
+
+typedef struct
+{
+	ButtonTrace trace;
+	uint8_t profile;
+	uint8_t derived;				// real presses taken from the settle time
+} TuneTrace;
+
+typedef struct
+{
+	const ButtonTimingProfile* candidates;
+	ButtonTuneResult* results;
+	uint16_t numCandidates;
+	const ButtonTrace* traces;
+	uint16_t numTraces;
+	uint16_t next;
+	pthread_mutex_t lock;
+} TuneJob;
+
+static TuneTrace** traces;
+static size_t numTraces;
+static uint8_t profileOf[TUNE_MAX_BUTTONS];
+
+static void* tune_Alloc(void* p, size_t size)
+{
+	p = realloc(p, size);
+	if(p == NULL && size != 0)
+	{
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+	return p;
+}
+
+//-------------- INPUT --------------//
+static uint8_t tune_ParseRange(const char* text, TuneRange* range)
+{
+	unsigned long min, max, step;
+	if(sscanf(text, "%lu:%lu:%lu", &min, &max, &step) != 3 || step == 0 || min > max || max > 0xFFFF)
+	{
+		return 0;
+	}
+	range->min = (uint32_t)min;
+	range->max = (uint32_t)max;
+	range->step = (uint32_t)step;
+	return 1;
+}
+
+static void tune_AddEdge(TuneTrace* trace, size_t* capacity, uint8_t level, uint32_t timestamp)
+{
+	if(trace->trace.numEdges == *capacity)
+	{
+		*capacity = *capacity ? *capacity * 2 : 256;
+		trace->trace.edges = (const ButtonEdge*)tune_Alloc((void*)trace->trace.edges, *capacity * sizeof(ButtonEdge));
+	}
+	ButtonEdge* edge = (ButtonEdge*)&trace->trace.edges[trace->trace.numEdges++];
+	edge->button = 0;
+	edge->level = level;
+	edge->timestamp = timestamp;
+}
+
+static void tune_AddPress(TuneTrace* trace, size_t* capacity, uint32_t timestamp, uint32_t duration, uint8_t doublePress)
+{
+	if(trace->trace.numPresses == *capacity)
+	{
+		*capacity = *capacity ? *capacity * 2 : 64;
+		trace->trace.presses = (const ButtonTunePress*)tune_Alloc((void*)trace->trace.presses, *capacity * sizeof(ButtonTunePress));
+	}
+	ButtonTunePress* press = (ButtonTunePress*)&trace->trace.presses[trace->trace.numPresses++];
+	press->timestamp = timestamp;
+	press->duration = duration;
+	press->doublePress = doublePress;
+}
+
+// Presses that stay down for the settle time, from the first contact of their bounce to the
+// first contact of the release's
+static void tune_DerivePresses(TuneTrace* trace, uint32_t settle)
+{
+	size_t capacity = 0;
+	uint8_t stable = 0;
+	uint8_t bouncing = 0;
+	uint32_t firstContact = 0;
+	uint32_t pressContact = 0;
+	const ButtonEdge* edges = trace->trace.edges;
+	for(size_t i=0; i<trace->trace.numEdges; i++)
+	{
+		if(!bouncing)
+		{
+			bouncing = 1;
+			firstContact = edges[i].timestamp;
+		}
+		uint8_t last = i + 1 == trace->trace.numEdges;
+		if(last || edges[i + 1].timestamp - edges[i].timestamp >= settle)
+		{
+			if(edges[i].level && !stable)
+			{
+				pressContact = firstContact;
+			}
+			else if(!edges[i].level && stable)
+			{
+				tune_AddPress(trace, &capacity, pressContact, firstContact - pressContact, BUTTONS_TUNE_ANY_PRESS);
+			}
+			stable = edges[i].level;
+			bouncing = 0;
+		}
+	}
+	if(stable)
+	{
+		// Still down when the capture ended
+		tune_AddPress(trace, &capacity, pressContact, 0, BUTTONS_TUNE_ANY_PRESS);
+	}
+	trace->derived = 1;
+}
+
+static int tune_ComparePress(const void* a, const void* b)
+{
+	uint32_t ta = ((const ButtonTunePress*)a)->timestamp;
+	uint32_t tb = ((const ButtonTunePress*)b)->timestamp;
+	return ta < tb ? -1 : (ta > tb ? 1 : 0);
+}
+
+static uint8_t tune_ReadPresses(const char* path, TuneTrace** byButton)
+{
+	char name[4096];
+	snprintf(name, sizeof(name), "%s.presses", path);
+	FILE* file = fopen(name, "r");
+	if(file == NULL)
+	{
+		return 0;
+	}
+	size_t capacity[TUNE_MAX_BUTTONS] = {0};
+	char line[256];
+	while(fgets(line, sizeof(line), file) != NULL)
+	{
+		unsigned button;
+		unsigned long timestamp, duration = 0;
+		char kind = 's';
+		if(line[0] == '#' || sscanf(line, "%u %lu", &button, &timestamp) != 2)
+		{
+			continue;
+		}
+		// The duration and kind are both optional
+		if(sscanf(line, "%*u %*u %lu %c", &duration, &kind) < 1)
+		{
+			sscanf(line, "%*u %*u %c", &kind);
+		}
+		if(button >= TUNE_MAX_BUTTONS || byButton[button] == NULL)
+		{
+			fprintf(stderr, "%s: press of button %u, which has no edges\n", name, button);
+			continue;
+		}
+		tune_AddPress(byButton[button], &capacity[button], (uint32_t)timestamp, (uint32_t)duration, kind == 'd');
+	}
+	fclose(file);
+	for(unsigned b=0; b<TUNE_MAX_BUTTONS; b++)
+	{
+		if(byButton[b] != NULL)
+		{
+			qsort((void*)byButton[b]->trace.presses, byButton[b]->trace.numPresses, sizeof(ButtonTunePress), tune_ComparePress);
+		}
+	}
+	return 1;
+}
+
+static void tune_ReadTrace(const char* path, uint32_t settle)
+{
+	FILE* file = fopen(path, "rb");
+	if(file == NULL)
+	{
+		fprintf(stderr, "can't open %s\n", path);
+		exit(1);
+	}
+	uint8_t* data = NULL;
+	size_t size = 0, capacity = 0, got;
+	do
+	{
+		capacity += 65536;
+		data = (uint8_t*)tune_Alloc(data, capacity);
+		got = fread(&data[size], 1, capacity - size, file);
+		size += got;
+	} while(got != 0);
+	fclose(file);
+
+	TuneTrace* byButton[TUNE_MAX_BUTTONS] = {0};
+	size_t edgeCapacity[TUNE_MAX_BUTTONS] = {0};
+	uint32_t dropped = 0, skipped = 0;
+	for(size_t i=0; i + BUTTONS_TRACE_RECORD_SIZE <= size; )
+	{
+		const uint8_t* r = &data[i];
+		if(r[0] != BUTTONS_TRACE_SYNC || r[1] > ButtonTraceDropped)
+		{
+			i++;
+			skipped++;
+			continue;
+		}
+		uint32_t timestamp = r[4] | (r[5] << 8) | (r[6] << 16) | ((uint32_t)r[7] << 24);
+		i += BUTTONS_TRACE_RECORD_SIZE;
+		if(r[1] == ButtonTraceDropped)
+		{
+			dropped = timestamp;
+			continue;
+		}
+		if(r[1] == ButtonTraceEvent || r[2] >= TUNE_MAX_BUTTONS)
+		{
+			continue;
+		}
+		if(byButton[r[2]] == NULL)
+		{
+			TuneTrace* trace = (TuneTrace*)tune_Alloc(NULL, sizeof(TuneTrace));
+			memset(trace, 0, sizeof(TuneTrace));
+			trace->profile = profileOf[r[2]];
+			traces = (TuneTrace**)tune_Alloc(traces, (numTraces + 1) * sizeof(TuneTrace*));
+			traces[numTraces++] = trace;
+			byButton[r[2]] = trace;
+		}
+		tune_AddEdge(byButton[r[2]], &edgeCapacity[r[2]], r[3], timestamp);
+	}
+	free(data);
+	if(dropped != 0 || skipped != 0)
+	{
+		fprintf(stderr, "%s: %u records dropped by the sink, %u bytes skipped\n", path, dropped, skipped);
+	}
+	if(!tune_ReadPresses(path, byButton))
+	{
+		for(unsigned b=0; b<TUNE_MAX_BUTTONS; b++)
+		{
+			if(byButton[b] != NULL)
+			{
+				tune_DerivePresses(byButton[b], settle);
+			}
+		}
+	}
+}
+
+//-------------- EVALUATION --------------//
+static void* tune_Worker(void* arg)
+{
+	TuneJob* job = (TuneJob*)arg;
+	Button scratch;
+	memset(&scratch, 0, sizeof(scratch));
+	for(;;)
+	{
+		pthread_mutex_lock(&job->lock);
+		uint16_t c = job->next < job->numCandidates ? job->next++ : job->numCandidates;
+		pthread_mutex_unlock(&job->lock);
+		if(c == job->numCandidates)
+		{
+			return NULL;
+		}
+		buttons_TuneEvaluate(&job->candidates[c], job->traces, job->numTraces, &scratch, &job->results[c]);
+	}
+}
+
+static void tune_PrintCandidate(const ButtonTimingProfile* candidate, const ButtonTuneResult* result)
+{
+	printf("%6u %6u %6u  %6u %7u %6u %6u  ", candidate->debounceLowToHigh, candidate->debounceHighToLow,
+			candidate->doublePressTime, result->falsePresses, result->falseReleases, result->missedPresses,
+			result->doublePressErrors);
+	if(result->matchedPresses == 0)
+	{
+		printf("%7s %5s\n", "-", "-");
+	}
+	else
+	{
+		printf("%7.1f %5u\n", buttons_TuneMeanLatency(result) / 16.0, result->latencyMax);
+	}
+}
+
+static const ButtonTuneResult* sortResults;
+
+static int tune_CompareFront(const void* a, const void* b)
+{
+	const ButtonTuneResult* ra = &sortResults[*(const uint16_t*)a];
+	const ButtonTuneResult* rb = &sortResults[*(const uint16_t*)b];
+	uint32_t ea = buttons_TuneErrors(ra), eb = buttons_TuneErrors(rb);
+	if(ea != eb)
+	{
+		return ea < eb ? -1 : 1;
+	}
+	uint32_t la = buttons_TuneMeanLatency(ra), lb = buttons_TuneMeanLatency(rb);
+	return la < lb ? -1 : (la > lb ? 1 : 0);
+}
+
+static void tune_Profile(uint8_t profile, const ButtonTimingProfile* candidates, uint16_t numCandidates, uint16_t threads)
+{
+	ButtonTrace* selected = NULL;
+	uint16_t count = 0;
+	size_t presses = 0, derived = 0;
+	for(size_t t=0; t<numTraces; t++)
+	{
+		if(traces[t]->profile == profile && count < 0xFFFF)
+		{
+			selected = (ButtonTrace*)tune_Alloc(selected, (count + 1) * sizeof(ButtonTrace));
+			selected[count++] = traces[t]->trace;
+			presses += traces[t]->trace.numPresses;
+			derived += traces[t]->derived ? traces[t]->trace.numPresses : 0;
+		}
+	}
+	if(count == 0)
+	{
+		return;
+	}
+
+	TuneJob job;
+	job.candidates = candidates;
+	job.results = (ButtonTuneResult*)tune_Alloc(NULL, numCandidates * sizeof(ButtonTuneResult));
+	job.numCandidates = numCandidates;
+	job.traces = selected;
+	job.numTraces = count;
+	job.next = 0;
+	pthread_mutex_init(&job.lock, NULL);
+	pthread_t workers[TUNE_MAX_THREADS];
+	for(uint16_t w=0; w<threads; w++)
+	{
+		pthread_create(&workers[w], NULL, tune_Worker, &job);
+	}
+	for(uint16_t w=0; w<threads; w++)
+	{
+		pthread_join(workers[w], NULL);
+	}
+
+	uint8_t* front = (uint8_t*)tune_Alloc(NULL, numCandidates);
+	uint16_t* order = (uint16_t*)tune_Alloc(NULL, numCandidates * sizeof(uint16_t));
+	uint16_t frontSize = buttons_TuneParetoFront(job.results, numCandidates, front);
+	uint16_t n = 0;
+	for(uint16_t c=0; c<numCandidates; c++)
+	{
+		if(front[c])
+		{
+			order[n++] = c;
+		}
+	}
+	sortResults = job.results;
+	qsort(order, n, sizeof(order[0]), tune_CompareFront);
+
+	printf("profile %u: %u traces, %zu real presses (%zu from the settle time), %u candidates\n",
+			profile, count, presses, derived, numCandidates);
+	printf("Pareto front of false events, missed presses and mean latency (%u candidates):\n", frontSize);
+	printf("   L2H    H2L double   false release missed double  latency   max\n");
+	for(uint16_t i=0; i<n; i++)
+	{
+		tune_PrintCandidate(&candidates[order[i]], &job.results[order[i]]);
+	}
+	uint16_t best = buttons_TuneSelect(candidates, job.results, numCandidates);
+	printf("recommended: {%u, %u, %u, 0}\n", candidates[best].debounceLowToHigh,
+			candidates[best].debounceHighToLow, candidates[best].doublePressTime);
+	tune_PrintCandidate(&candidates[best], &job.results[best]);
+	printf("\n");
+
+	free(order);
+	free(front);
+	free(job.results);
+	free(selected);
+}
+
+int main(int argc, char** argv)
+{
+	TuneRange lowToHigh = {0, 30, 2}, highToLow = {0, 60, 5}, doublePress = {200, 400, 50};
+	uint32_t settle = 20;
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	uint16_t threads = (uint16_t)(cores > 0 ? cores : 1);
+	int opt;
+
+	while((opt = getopt(argc, argv, "l:h:d:s:p:j:")) != -1)
+	{
+		unsigned button, profile;
+		switch(opt)
+		{
+		case 'l':
+			if(!tune_ParseRange(optarg, &lowToHigh)) goto usage;
+			break;
+		case 'h':
+			if(!tune_ParseRange(optarg, &highToLow)) goto usage;
+			break;
+		case 'd':
+			if(!tune_ParseRange(optarg, &doublePress)) goto usage;
+			break;
+		case 's':
+			settle = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			if(sscanf(optarg, "%u=%u", &button, &profile) != 2 || button >= TUNE_MAX_BUTTONS || profile >= TUNE_MAX_PROFILES)
+				goto usage;
+			profileOf[button] = (uint8_t)profile;
+			break;
+		case 'j':
+			threads = (uint16_t)strtoul(optarg, NULL, 0);
+			if(threads == 0 || threads > TUNE_MAX_THREADS) goto usage;
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if(optind == argc)
+	{
+		goto usage;
+	}
+
+	size_t numCandidates = (size_t)((lowToHigh.max - lowToHigh.min) / lowToHigh.step + 1) *
+							((highToLow.max - highToLow.min) / highToLow.step + 1) *
+							((doublePress.max - doublePress.min) / doublePress.step + 1);
+	if(numCandidates > 0xFFFF)
+	{
+		fprintf(stderr, "%zu candidates, at most 65535\n", numCandidates);
+		return 1;
+	}
+	ButtonTimingProfile* candidates = (ButtonTimingProfile*)tune_Alloc(NULL, numCandidates * sizeof(ButtonTimingProfile));
+	size_t c = 0;
+	for(uint32_t l=lowToHigh.min; l<=lowToHigh.max; l+=lowToHigh.step)
+	for(uint32_t h=highToLow.min; h<=highToLow.max; h+=highToLow.step)
+	for(uint32_t d=doublePress.min; d<=doublePress.max; d+=doublePress.step)
+	{
+		candidates[c].debounceLowToHigh = (uint16_t)l;
+		candidates[c].debounceHighToLow = (uint16_t)h;
+		candidates[c].doublePressTime = (uint16_t)d;
+		candidates[c].holdTime = 0;
+		c++;
+	}
+
+	for(int i=optind; i<argc; i++)
+	{
+		tune_ReadTrace(argv[i], settle);
+	}
+	for(uint8_t profile=0; profile<TUNE_MAX_PROFILES; profile++)
+	{
+		tune_Profile(profile, candidates, (uint16_t)numCandidates, threads);
+	}
+	free(candidates);
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: tune_advisor [-l min:max:step] [-h min:max:step] [-d min:max:step] [-s settle]\n"
+					"                    [-p button=profile]... [-j threads] trace...\n");
+	return 1;
+}